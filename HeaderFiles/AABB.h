@@ -234,6 +234,12 @@ class HitBox
 public:
 	AABB local_aabb;
 	AABB world_aabb;
+	// the box the line mesh was built from, local_aabb can move away from it
+	AABB mesh_aabb;
+	// bounds of the skinned pose, only for attack + pickup tests, movement keeps colliding with local_aabb
+	bool skinned = false;
+	AABB skinned_aabb;
+	AABB skinned_world_aabb;
 
 	bool ifdraw;
 	Mesh mesh;
@@ -252,6 +258,7 @@ public:
 		shader_manager = _shader_manager;
 		psos = _psos;
 		local_aabb = aabb;
+		mesh_aabb = aabb;
 
 		build_mesh_from_aabb(core, local_aabb);
 
@@ -300,11 +307,36 @@ public:
 	{
 		world_aabb = local_aabb.transform(world);
 		world_aabb.update_cache();
+		if (skinned)
+		{
+			skinned_world_aabb = skinned_aabb.transform(world);
+			skinned_world_aabb.update_cache();
+		}
+	}
+
+	//attack + pickup box: the skinned bounds when there are any, else the collision box
+	const AABB& hit_aabb() const
+	{
+		return skinned ? skinned_world_aabb : world_aabb;
+	}
+
+	//maps the line mesh box onto local_aabb
+	Matrix mesh_fit()
+	{
+		Vec3 from_center = mesh_aabb.get_center();
+		Vec3 from_half = mesh_aabb.get_halfSize();
+		Vec3 to_center = local_aabb.get_center();
+		Vec3 to_half = local_aabb.get_halfSize();
+		Vec3 scale(from_half.x > 0 ? to_half.x / from_half.x : 1.0f,
+			from_half.y > 0 ? to_half.y / from_half.y : 1.0f,
+			from_half.z > 0 ? to_half.z / from_half.z : 1.0f);
+		return Matrix::Translate(to_center).mul(Matrix::Scaling(scale)).mul(Matrix::Translate(-from_center));
 	}
 
 	void update(Matrix& world, Matrix& vp)
 	{
-		shader_manager->update(vs_name, "staticMeshBuffer", "W", &world);
+		Matrix fitted = world.mul(mesh_fit());
+		shader_manager->update(vs_name, "staticMeshBuffer", "W", &fitted);
 		shader_manager->update(vs_name, "staticMeshBuffer", "VP", &vp);
 	}
 
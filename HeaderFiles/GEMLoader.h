@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <vector>
 #include <string>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -284,48 +285,38 @@ namespace GEMLoader
 
 			// Load the material properties for this mesh
 			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+			mesh.material.properties.reserve(n);
 			for (unsigned int i = 0; i < n; i++)
 			{
 				mesh.material.properties.push_back(loadProperty(file));
 			}
 
+			// Vertices and indices are stored back to back, each array is read with a single call
 			// If it's static
 			if (isAnimated == 0)
 			{
 				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					GEMStaticVertex v;
-					file.read(reinterpret_cast<char*>(&v), sizeof(GEMStaticVertex));
-					mesh.verticesStatic.push_back(v);
-				}
-
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					unsigned int index = 0;
-					file.read(reinterpret_cast<char*>(&index), sizeof(unsigned int));
-					mesh.indices.push_back(index);
-				}
+				loadArray(file, mesh.verticesStatic, n);
 			}
 			// If it's animated
 			else
 			{
 				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					GEMAnimatedVertex v;
-					file.read(reinterpret_cast<char*>(&v), sizeof(GEMAnimatedVertex));
-					mesh.verticesAnimated.push_back(v);
-				}
+				loadArray(file, mesh.verticesAnimated, n);
+			}
 
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					unsigned int index = 0;
-					file.read(reinterpret_cast<char*>(&index), sizeof(unsigned int));
-					mesh.indices.push_back(index);
-				}
+			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+			loadArray(file, mesh.indices, n);
+		}
+
+		// Sizes the vector to n elements and fills it with one read
+		template<typename T>
+		void loadArray(std::ifstream& file, std::vector<T>& values, unsigned int n)
+		{
+			values.resize(n);
+			if (n > 0)
+			{
+				file.read(reinterpret_cast<char*>(values.data()), sizeof(T) * n);
 			}
 		}
 
@@ -335,12 +326,14 @@ namespace GEMLoader
 		{
 			int l = 0;
 			file.read(reinterpret_cast<char*>(&l), sizeof(int));
-			char* buffer = new char[l + 1];
-			memset(buffer, 0, l * sizeof(char));
-			file.read(buffer, l * sizeof(char));
-			buffer[l] = 0;
-			std::string str(buffer);
-			delete[] buffer;
+			if (l <= 0)
+			{
+				return std::string();
+			}
+			// Read straight into the string, it ends at the first 0 like a C string would
+			std::string str(l, '\0');
+			file.read(&str[0], l * sizeof(char));
+			str.resize(strlen(str.c_str()));
 			return str;
 		}
 
@@ -369,37 +362,30 @@ namespace GEMLoader
 		}
 
 		// Loads data for a single animation frame, including position, rotation, and scale for each bone
+		// The frame is built in place, each of its three arrays is one read
 		void loadFrame(GEMAnimationSequence& aseq, std::ifstream& file, int bonesN)
 		{
-			GEMAnimationFrame frame;
+			aseq.frames.emplace_back();
+			GEMAnimationFrame& frame = aseq.frames.back();
+			unsigned int n = bonesN > 0 ? bonesN : 0;
 
 			// Load positions
-			for (int i = 0; i < bonesN; i++)
-			{
-				GEMVec3 p = loadVec3(file);
-				frame.positions.push_back(p);
-			}
+			loadArray(file, frame.positions, n);
 
 			// Load rotations
-			for (int i = 0; i < bonesN; i++)
-			{
-				GEMQuaternion q = loadQuaternion(file);
-				frame.rotations.push_back(q);
-			}
+			loadArray(file, frame.rotations, n);
 
 			// Load scales
-			for (int i = 0; i < bonesN; i++)
-			{
-				GEMVec3 s = loadVec3(file);
-				frame.scales.push_back(s);
-			}
-
-			aseq.frames.push_back(frame);
+			loadArray(file, frame.scales, n);
 		}
 
 		// Loads multiple frames for an animation sequence
 		void loadFrames(GEMAnimationSequence& aseq, std::ifstream& file, int bonesN, int frames)
 		{
+			if (frames > 0)
+			{
+				aseq.frames.reserve(frames);
+			}
 			for (int i = 0; i < frames; i++)
 			{
 				loadFrame(aseq, file, bonesN);
@@ -445,12 +431,12 @@ namespace GEMLoader
 			file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
 			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
 
-			// Load each mesh
+			// Load each mesh in place
+			meshes.reserve(meshes.size() + n);
 			for (unsigned int i = 0; i < n; i++)
 			{
-				GEMMesh mesh;
-				loadMesh(file, mesh, isAnimated);
-				meshes.push_back(mesh);
+				meshes.emplace_back();
+				loadMesh(file, meshes.back(), isAnimated);
 			}
 			file.close();
 		}
@@ -474,24 +460,25 @@ namespace GEMLoader
 			file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
 			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
 
-			// Load each mesh
+			// Load each mesh in place
+			meshes.reserve(meshes.size() + n);
 			for (unsigned int i = 0; i < n; i++)
 			{
-				GEMMesh mesh;
-				loadMesh(file, mesh, isAnimated);
-				meshes.push_back(mesh);
+				meshes.emplace_back();
+				loadMesh(file, meshes.back(), isAnimated);
 			}
 
 			// Read skeleton (bone) data
 			unsigned int bonesN = 0;
 			file.read(reinterpret_cast<char*>(&bonesN), sizeof(unsigned int));
+			animation.bones.reserve(bonesN);
 			for (unsigned int i = 0; i < bonesN; i++)
 			{
-				GEMBone bone;
+				animation.bones.emplace_back();
+				GEMBone& bone = animation.bones.back();
 				bone.name = loadString(file);
 				bone.offset = loadMatrix(file);
 				file.read(reinterpret_cast<char*>(&bone.parentIndex), sizeof(int));
-				animation.bones.push_back(bone);
 			}
 
 			// Read the global inverse matrix
@@ -499,15 +486,16 @@ namespace GEMLoader
 
 			// Read animation sequences
 			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+			animation.animations.reserve(n);
 			for (unsigned int i = 0; i < n; i++)
 			{
-				GEMAnimationSequence aseq;
+				animation.animations.emplace_back();
+				GEMAnimationSequence& aseq = animation.animations.back();
 				aseq.name = loadString(file);
 				int frames = 0;
 				file.read(reinterpret_cast<char*>(&frames), sizeof(int));
 				file.read(reinterpret_cast<char*>(&aseq.ticksPerSecond), sizeof(float));
 				loadFrames(aseq, file, bonesN, frames);
-				animation.animations.push_back(aseq);
 			}
 			file.close();
 		}
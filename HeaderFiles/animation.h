@@ -1,9 +1,25 @@
 #pragma once
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include "core.h"
 #include "vectors.h"
+#include "packed_clip.h"
+#include "pose.h"
+#include "palette_pool.h"
+
+//Clip handles
+/*
+- a clip handle is the index of the clip in Animation::clips, resolved once from the name
+- sampling by handle is a vector index instead of a std::map<std::string> lookup per bone
+- the name functions stay, they resolve the handle and forward
+*/
+typedef int ClipHandle;
+#define INVALID_CLIP_HANDLE -1
+// size of the bones array in the animated vertex shader
+#define ANIMATION_MAX_SHADER_BONES 256
 
 struct Bone
 {
@@ -16,8 +32,32 @@ struct Skeleton
 {
 	std::vector<Bone> bones;
 	Matrix globalInverse;
-	int findBone(std::string name)
+	// name -> bone, filled by buildIndex()
+	std::unordered_map<std::string, int> boneIndex;
+	// root first chain down to each bone, chains[i].back() == i
+	std::vector<std::vector<int>> chains;
+
+	//call once the bones are loaded
+	void buildIndex()
+	{
+		boneIndex.clear();
+		chains.assign(bones.size(), std::vector<int>());
+		for (int i = 0; i < (int)bones.size(); i++)
+		{
+			boneIndex[bones[i].name] = i;
+			for (int id = i; id != -1; id = bones[id].parentIndex)
+				chains[i].push_back(id);
+			std::reverse(chains[i].begin(), chains[i].end());
+		}
+	}
+
+	int findBone(const std::string& name) const
 	{
+		if (!boneIndex.empty())
+		{
+			auto it = boneIndex.find(name);
+			return it != boneIndex.end() ? it->second : -1;
+		}
 		for (int i = 0; i < bones.size(); i++)
 		{
 			if (bones[i].name == name)
@@ -29,6 +69,37 @@ struct Skeleton
 	}
 };
 
+//per bone weights for masked blends, 0 = untouched, 1 = full weight
+struct BoneMask
+{
+	std::vector<float> weights;
+
+	void init(const Skeleton& skeleton, float weight = 0.0f)
+	{
+		weights.assign(skeleton.bones.size(), weight);
+	}
+
+	//the bone and everything below it
+	void setBranch(const Skeleton& skeleton, int bone, float weight)
+	{
+		if (weights.size() != skeleton.bones.size())
+			init(skeleton);
+		for (int i = 0; i < (int)skeleton.bones.size(); i++)
+		{
+			int id = i;
+			while (id != -1 && id != bone)
+				id = skeleton.bones[id].parentIndex;
+			if (id == bone)
+				weights[i] = weight;
+		}
+	}
+
+	const float* data() const
+	{
+		return weights.empty() ? nullptr : weights.data();
+	}
+};
+
 struct AnimationFrame
 {
 	std::vector<Vec3> positions;
@@ -40,6 +111,8 @@ class AnimationSequence
 {
 public:
 	std::vector<AnimationFrame> frames;
+	// filled by pack(), frames is released then
+	PackedClip packed;
 	float ticksPerSecond;
 	Vec3 interpolate(Vec3 p1, Vec3 p2, float t) {
 		return ((p1 * (1.0f - t)) + (p2 * t));
@@ -47,8 +120,14 @@ public:
 	Quaternion interpolate(Quaternion q1, Quaternion q2, float t) {
 		return Quaternion::slerp(q1, q2, t);
 	}
+	bool isPacked() const {
+		return !packed.empty();
+	}
+	int frameCount() const {
+		return isPacked() ? (int)packed.frame_count : (int)frames.size();
+	}
 	float duration() {
-		return ((float)frames.size() / ticksPerSecond);
+		return ((float)frameCount() / ticksPerSecond);
 	}
 	// Find frame given time
 	void calcFrame(float t, int& frame, float& interpolationFact)
@@ -56,24 +135,87 @@ public:
 		interpolationFact = t * ticksPerSecond;
 		frame = (int)floorf(interpolationFact);
 		interpolationFact = interpolationFact - (float)frame;
-		frame = min(frame, frames.size() - 1);
+		frame = min(frame, frameCount() - 1);
 	}
 	//Find next frame
 	int nextFrame(int frame)
 	{
-		return min(frame + 1, frames.size() - 1);
+		return min(frame + 1, frameCount() - 1);
+	}
+
+	//move the keyframes into the packed buffer and free the per frame vectors
+	void pack()
+	{
+		if (frames.empty())
+			return;
+		packed.build(frames);
+		std::vector<AnimationFrame>().swap(frames);
+	}
+
+	//heap + object size of the keyframes, whichever format is in use
+	size_t memoryBytes() const
+	{
+		if (isPacked())
+			return packed.memory_bytes();
+		size_t bytes = frames.capacity() * sizeof(AnimationFrame);
+		for (const AnimationFrame& f : frames)
+		{
+			bytes += f.positions.capacity() * sizeof(Vec3) + f.rotations.capacity() * sizeof(Quaternion)
+				+ f.scales.capacity() * sizeof(Vec3);
+		}
+		return bytes;
+	}
+
+	//local TRS of one bone between baseFrame and the next one
+	void sampleBone(int baseFrame, float interpolationFact, int boneIndex, Vec3& position, Quaternion& rotation, Vec3& scale)
+	{
+		int next = nextFrame(baseFrame);
+		if (isPacked())
+		{
+			// lazy clip that was never loaded (ModelRegistry::use_clip), nothing to read
+			if (!packed.resident())
+				return;
+			packed.sample(baseFrame, next, interpolationFact, boneIndex, position, rotation, scale);
+			return;
+		}
+		scale = interpolate(frames[baseFrame].scales[boneIndex], frames[next].scales[boneIndex], interpolationFact);
+		rotation = interpolate(frames[baseFrame].rotations[boneIndex], frames[next].rotations[boneIndex], interpolationFact);
+		position = interpolate(frames[baseFrame].positions[boneIndex], frames[next].positions[boneIndex], interpolationFact);
+	}
+
+	//local TRS of every bone at time t, bones with skip[i] != 0 keep what they had
+	//a lazy clip that is not loaded samples nothing, the whole pose keeps what it had
+	int samplePose(float t, int boneCount, LocalPose& pose, const unsigned char* skip = nullptr)
+	{
+		if (isPacked() && !packed.resident())
+		{
+			pose.resize(boneCount);
+			return 0;
+		}
+		int frame = 0;
+		float interpolationFact = 0;
+		calcFrame(t, frame, interpolationFact);
+		pose.resize(boneCount);
+		int sampled = 0;
+		for (int i = 0; i < boneCount; i++)
+		{
+			if (skip && skip[i])
+				continue;
+			BonePose& b = pose.bones[i];
+			sampleBone(frame, interpolationFact, i, b.position, b.rotation, b.scale);
+			sampled++;
+		}
+		return sampled;
 	}
 
 	Matrix interpolateBoneToGlobal(Matrix* matrices, int baseFrame, float interpolationFact,
 		Skeleton* skeleton, int boneIndex)
 	{
-		Matrix scale = Matrix::Scaling(interpolate(frames[baseFrame].scales[boneIndex],
-			frames[nextFrame(baseFrame)].scales[boneIndex], interpolationFact));
-		Matrix rotation = interpolate(frames[baseFrame].rotations[boneIndex],
-			frames[nextFrame(baseFrame)].rotations[boneIndex], interpolationFact).toMatrix();
-		Matrix translation = Matrix::Translate(interpolate(frames[baseFrame].positions[boneIndex],
-			frames[nextFrame(baseFrame)].positions[boneIndex], interpolationFact));
-		Matrix local = translation * rotation * scale;
+		Vec3 position;
+		Quaternion rotation;
+		Vec3 scale;
+		sampleBone(baseFrame, interpolationFact, boneIndex, position, rotation, scale);
+		Matrix local = Matrix::Translate(position) * rotation.toMatrix() * Matrix::Scaling(scale);
 		if (skeleton->bones[boneIndex].parentIndex > -1)
 		{
 			Matrix global = matrices[skeleton->bones[boneIndex].parentIndex] * local;
@@ -88,21 +230,83 @@ class Animation
 {
 public:
 	std::map<std::string, AnimationSequence> animations;
+	// handle -> clip, the map nodes never move so the pointers stay valid
+	std::vector<AnimationSequence*> clips;
+	std::vector<std::string> clipNames;
 	Skeleton skeleton;
 	int bonesSize()
 	{
 		return skeleton.bones.size();
 	}
 
-	void calcFrame(std::string name, float t, int& frame, float& interpolationFact) {
-		animations[name].calcFrame(t, frame, interpolationFact);
+	ClipHandle addAnimation(const std::string& name, const AnimationSequence& sequence)
+	{
+		auto it = animations.find(name);
+		if (it != animations.end())
+		{
+			it->second = sequence;
+			return findClip(name);
+		}
+		it = animations.insert({ name, sequence }).first;
+		clips.push_back(&it->second);
+		clipNames.push_back(name);
+		return (ClipHandle)clips.size() - 1;
+	}
+
+	//resolve once, keep the handle
+	ClipHandle findClip(const std::string& name) const
+	{
+		for (int i = 0; i < clipNames.size(); i++)
+		{
+			if (clipNames[i] == name)
+				return i;
+		}
+		return INVALID_CLIP_HANDLE;
 	}
 
-	Matrix interpolateBoneToGlobal(std::string name, Matrix* matrices, int baseFrame, float
+	bool validClip(ClipHandle clip) const
+	{
+		return clip >= 0 && clip < (ClipHandle)clips.size();
+	}
+
+	AnimationSequence* clip(ClipHandle handle)
+	{
+		return clips[handle];
+	}
+
+	void calcFrame(ClipHandle clip, float t, int& frame, float& interpolationFact) {
+		clips[clip]->calcFrame(t, frame, interpolationFact);
+	}
+
+	Matrix interpolateBoneToGlobal(ClipHandle clip, Matrix* matrices, int baseFrame, float
 		interpolationFact, int boneIndex) {
-		return animations[name].interpolateBoneToGlobal(matrices, baseFrame,
+		return clips[clip]->interpolateBoneToGlobal(matrices, baseFrame,
 			interpolationFact, &skeleton, boneIndex);
 	}
+
+	void calcFrame(const std::string& name, float t, int& frame, float& interpolationFact) {
+		ClipHandle clip = findClip(name);
+		if (!validClip(clip)) { frame = 0; interpolationFact = 0; return; }
+		calcFrame(clip, t, frame, interpolationFact);
+	}
+
+	Matrix interpolateBoneToGlobal(const std::string& name, Matrix* matrices, int baseFrame, float
+		interpolationFact, int boneIndex) {
+		ClipHandle clip = findClip(name);
+		if (!validClip(clip)) { return Matrix(); }
+		return interpolateBoneToGlobal(clip, matrices, baseFrame, interpolationFact, boneIndex);
+	}
+	//parent * local for the whole pose, parents come before their children
+	void localToGlobal(const LocalPose& pose, Matrix* matrices)
+	{
+		for (int i = 0; i < bonesSize(); i++)
+		{
+			Matrix local = pose.bones[i].toMatrix();
+			int parent = skeleton.bones[i].parentIndex;
+			matrices[i] = parent > -1 ? matrices[parent] * local : local;
+		}
+	}
+
 	//Calculate final transformation matrix
 	void calcFinalTransforms(Matrix* matrices)
 	{
@@ -112,7 +316,16 @@ public:
 		}
 	}
 
-	bool hasAnimation(std::string name)
+	//same, keeps the global matrices
+	void calcFinalTransforms(Matrix* globals, Matrix* matrices)
+	{
+		for (int i = 0; i < bonesSize(); i++)
+		{
+			matrices[i] = globals[i] * skeleton.bones[i].offset * skeleton.globalInverse;
+		}
+	}
+
+	bool hasAnimation(const std::string& name)
 	{
 		if (animations.find(name) == animations.end())
 		{
@@ -122,19 +335,147 @@ public:
 	}
 };
 
+//Baked palettes
+/*
+- a herd playing the same few clips samples the same poses over and over
+- bake() samples each chosen clip at a fixed rate into final skinning palettes, all in one array
+- an instance with baked set looks up (clip, frame) instead of sampling, optionally lerping to the next frame
+- no layers, no bone skipping, cross-fades lerp the two palettes
+*/
+#define BAKED_PALETTE_RATE 30.0f
+
+class BakedPalettes
+{
+public:
+	struct BakedClip
+	{
+		int offset = -1; // first matrix of frame 0, -1 = not baked
+		int frames = 0;
+	};
+	// clip after clip, frame after frame, bones matrices per frame
+	std::vector<Matrix> palettes;
+	std::vector<BakedClip> clips;
+	float rate = BAKED_PALETTE_RATE;
+	int bones = 0;
+
+	void bake(Animation* animation, const std::vector<ClipHandle>& clipList, float _rate = BAKED_PALETTE_RATE)
+	{
+		rate = _rate;
+		bones = animation->bonesSize();
+		clips.assign(animation->clips.size(), BakedClip());
+		palettes.clear();
+		LocalPose pose;
+		std::vector<Matrix> globals(bones);
+		for (ClipHandle clip : clipList)
+		{
+			if (!animation->validClip(clip) || clips[clip].offset >= 0)
+				continue;
+			AnimationSequence* sequence = animation->clip(clip);
+			int frames = (int)floorf(sequence->duration() * rate) + 1;
+			clips[clip].offset = (int)palettes.size();
+			clips[clip].frames = frames;
+			palettes.resize(palettes.size() + (size_t)frames * bones);
+			for (int f = 0; f < frames; f++)
+			{
+				sequence->samplePose((float)f / rate, bones, pose);
+				animation->localToGlobal(pose, globals.data());
+				animation->calcFinalTransforms(globals.data(), &palettes[clips[clip].offset + (size_t)f * bones]);
+			}
+		}
+	}
+
+	bool contains(ClipHandle clip) const
+	{
+		return clip >= 0 && clip < (ClipHandle)clips.size() && clips[clip].offset >= 0;
+	}
+
+	size_t memoryBytes() const
+	{
+		return palettes.capacity() * sizeof(Matrix) + clips.capacity() * sizeof(BakedClip);
+	}
+
+	//out = palette at t, keep > 0 blends it over what out already has (cross-fades)
+	void sample(ClipHandle clip, float t, bool lerp, Matrix* out, float keep = 0.0f) const
+	{
+		const BakedClip& baked = clips[clip];
+		float x = max(t, 0.0f) * rate;
+		int frame = min((int)x, baked.frames - 1);
+		int next = min(frame + 1, baked.frames - 1);
+		float fact = lerp ? x - (float)frame : 0.0f;
+		if (fact > 1.0f)
+			fact = 1.0f;
+		const Matrix* a = &palettes[baked.offset + (size_t)frame * bones];
+		const Matrix* b = &palettes[baked.offset + (size_t)next * bones];
+		if (fact == 0.0f && keep == 0.0f)
+		{
+			memcpy(out, a, bones * sizeof(Matrix));
+			return;
+		}
+		for (int i = 0; i < bones; i++)
+		{
+			for (int k = 0; k < 16; k++)
+			{
+				float v = a[i].m[k] + (b[i].m[k] - a[i].m[k]) * fact;
+				out[i].m[k] = out[i].m[k] * keep + v * (1.0f - keep);
+			}
+		}
+	}
+};
+
+//a clip on top of the base clip, lerped or added with its own weight and mask
+struct AnimationLayer
+{
+	ClipHandle clip = INVALID_CLIP_HANDLE;
+	Blend_Mode mode = BLEND_LERP;
+	float weight = 1.0f;
+	float t = 0;
+	const BoneMask* mask = nullptr;
+	// frame 0 of the clip, what an additive layer is relative to
+	LocalPose reference;
+};
+
 class AnimationInstance
 {
 public:
 	Animation* animation;
 	std::string currentAnimation;
+	ClipHandle currentClip = INVALID_CLIP_HANDLE;
 	float t;
-	Matrix matrices[256]; // This is defined as 256 to match the maximum number in the shader
-	Matrix matricesPose[256]; // This is to store transforms needed for finding bone positions
+	// both sized to the skeleton, from a PalettePool (see init)
+	Matrix* matrices = nullptr; // final palette, what the shader gets
+	Matrix* matricesPose = nullptr; // This is to store transforms needed for finding bone positions
+	Palette palette;
+	// clip + time matricesPose holds the global matrices of, set by update()
+	ClipHandle poseClip = INVALID_CLIP_HANDLE;
+	float poseTime = -1.0f;
 	Matrix coordTransform;
 
-	void init(Animation* _animation, int fromYZX)
+	// blended local pose of the last update
+	LocalPose pose;
+	// clip change through update() fades over this many seconds, 0 = hard switch
+	float crossFadeTime = 0;
+	// per bone, non zero bones are not sampled by update() and keep their last local pose (animation LOD)
+	// only while one clip plays: the last pose of a blend is blended already, a layer would be added onto it again
+	const unsigned char* skipBones = nullptr;
+	// bones sampled by the last update(), every clip counted
+	int bonesSampled = 0;
+	// clips in here are looked up instead of sampled, when there are no layers
+	const BakedPalettes* baked = nullptr;
+	bool bakedLerp = true;
+	std::vector<AnimationLayer> layers;
+
+	void init(Animation* _animation, int fromYZX, PalettePool* pool = &PalettePool::shared())
 	{
 		animation = _animation;
+		// matrices and matricesPose share one allocation
+		unsigned int bones = (unsigned int)max(animation->bonesSize(), 1);
+		palette.acquire(pool, 2 * bones);
+		matrices = palette.data;
+		matricesPose = palette.data + bones;
+		for (unsigned int i = 0; i < 2 * bones; i++)
+		{
+			matrices[i] = Matrix();
+		}
 		if (fromYZX == 1)
 		{
 			memset(coordTransform.a, 0, 16 * sizeof(float));
@@ -149,52 +490,234 @@ public:
 	{
 		t = 0;
 	}
+
+	//bytes of the palette the shader uses, the rest of the bones array is never read
+	unsigned int paletteBytes() const
+	{
+		return (unsigned int)(min(animation->bonesSize(), ANIMATION_MAX_SHADER_BONES) * sizeof(Matrix));
+	}
 	bool animationFinished()
 	{
-		if (t > animation->animations[currentAnimation].duration())
+		if (!animation->validClip(currentClip))
+		{
+			return false;
+		}
+		if (t > animation->clip(currentClip)->duration())
 		{
 			return true;
 		}
 		return false;
 	}
 
-	void update(std::string name, float dt) 
+	bool crossFading() const
+	{
+		return fadeClip != INVALID_CLIP_HANDLE;
+	}
+
+	//the clip fading out, INVALID_CLIP_HANDLE when there is none
+	ClipHandle fadingClip() const
+	{
+		return fadeClip;
+	}
+
+	//switch to clip, the old one keeps playing and fades out over duration
+	void crossFade(ClipHandle clip, float duration)
+	{
+		if (!animation->validClip(clip) || clip == currentClip)
+			return;
+		if (animation->validClip(currentClip) && duration > 0)
+		{
+			fadeClip = currentClip;
+			fadeT = t;
+			fadeElapsed = 0;
+			fadeDuration = duration;
+		}
+		currentClip = clip;
+		currentAnimation = animation->clipNames[clip];
+		t = 0;
+	}
+
+	int addLayer(ClipHandle clip, Blend_Mode mode, float weight, const BoneMask* mask = nullptr)
+	{
+		if (!animation->validClip(clip))
+			return -1;
+		AnimationLayer layer;
+		layer.clip = clip;
+		layer.mode = mode;
+		layer.weight = weight;
+		layer.mask = mask;
+		animation->clip(clip)->samplePose(0, animation->bonesSize(), layer.reference);
+		layers.push_back(layer);
+		return (int)layers.size() - 1;
+	}
+
+	void setLayerWeight(int layer, float weight)
+	{
+		layers[layer].weight = weight;
+	}
+
+	void update(ClipHandle clip, float dt)
 	{
-		if (name == currentAnimation) {
+		// unknown clip, keep the last pose
+		if (!animation->validClip(clip))
+		{
+			return;
+		}
+		if (clip == currentClip) {
 			t += dt;
 		}
-		else 
+		else
 		{
-			currentAnimation = name; t = 0;
+			crossFade(clip, crossFadeTime);
 		}
 		if (animationFinished() == true) { resetAnimationTime(); }
-		int frame = 0;
-		float interpolationFact = 0;
-		animation->calcFrame(name, t, frame, interpolationFact);
-		for (int i = 0; i < animation->bonesSize(); i++)
+
+		if (useBaked())
 		{
-			matrices[i] = animation->interpolateBoneToGlobal(name, matrices, frame, interpolationFact, i);
+			updateBaked(dt);
+			return;
 		}
-		animation->calcFinalTransforms(matrices);
+
+		if (crossFading())
+		{
+			// the outgoing clip keeps running while it fades
+			fadeElapsed += dt;
+			fadeT = advance(fadeClip, fadeT, dt);
+			if (fadeElapsed >= fadeDuration)
+			{
+				fadeClip = INVALID_CLIP_HANDLE;
+			}
+		}
+		for (AnimationLayer& layer : layers)
+		{
+			layer.t = advance(layer.clip, layer.t, dt);
+		}
+
+		// the first pose has to have every bone, a blend samples every bone of every clip
+		bool skip = pose.count() == animation->bonesSize() && !crossFading() && layers.empty();
+		bonesSampled = blendPoseNow(skip ? skipBones : nullptr);
+
+		// one global pass whatever was blended, the globals stay for findWorldMatrix
+		animation->localToGlobal(pose, matricesPose);
+		animation->calcFinalTransforms(matricesPose, matrices);
+		poseClip = currentClip;
+		poseTime = t;
+	}
+
+	void update(const std::string& name, float dt)
+	{
+		update(animation->findClip(name), dt);
 	}
 
-	Matrix findWorldMatrix(std::string boneName)
+	Matrix findWorldMatrix(const std::string& boneName)
 	{
-		int boneID = animation->skeleton.findBone(boneName);
-		std::vector<int> boneChain;
-		int ID = boneID;
-		while (ID != -1)
+		return findWorldMatrix(animation->skeleton.findBone(boneName));
+	}
+
+	//resolve the bone once with Skeleton::findBone and keep the index
+	//after update() it is the drawn pose; when t moved without one, the pose at the new time:
+	//	one clip: only the bone's chain is sampled, blended (cross-fade, layers): the whole blended pose
+	//	a cross-fade of baked clips blended the palettes, this blends the local poses, close but not the same
+	Matrix findWorldMatrix(int boneID)
+	{
+		if (boneID < 0 || boneID >= animation->bonesSize() || !animation->validClip(currentClip))
+		{
+			return coordTransform;
+		}
+		// update() already has the globals of this time
+		if (poseClip == currentClip && poseTime == t)
 		{
-			boneChain.push_back(ID);
-			ID = animation->skeleton.bones[ID].parentIndex;
+			return (matricesPose[boneID] * coordTransform);
 		}
+		// blended, one clip's chain is not what is drawn
+		if (crossFading() || !layers.empty())
+		{
+			blendPoseNow(nullptr);
+			animation->localToGlobal(pose, matricesPose);
+			poseClip = currentClip;
+			poseTime = t;
+			return (matricesPose[boneID] * coordTransform);
+		}
+		// time moved without an update, sample only the bone and its ancestors
+		if (animation->skeleton.chains.size() != animation->skeleton.bones.size())
+		{
+			animation->skeleton.buildIndex();
+		}
+		AnimationSequence* sequence = animation->clip(currentClip);
 		int frame = 0;
 		float interpolationFact = 0;
-		animation->calcFrame(currentAnimation, t, frame, interpolationFact);
-		for (int i = boneChain.size() - 1; i > -1; i = i - 1)
+		sequence->calcFrame(t, frame, interpolationFact);
+		for (int bone : animation->skeleton.chains[boneID])
 		{
-			matricesPose[boneChain[i]] = animation->interpolateBoneToGlobal(currentAnimation, matricesPose, frame, interpolationFact, boneChain[i]);
+			matricesPose[bone] = sequence->interpolateBoneToGlobal(matricesPose, frame, interpolationFact, &animation->skeleton, bone);
 		}
+		// the other globals are stale now
+		poseClip = INVALID_CLIP_HANDLE;
 		return (matricesPose[boneID] * coordTransform);
 	}
+
+private:
+	// outgoing clip of a cross-fade
+	ClipHandle fadeClip = INVALID_CLIP_HANDLE;
+	float fadeT = 0;
+	float fadeElapsed = 0;
+	float fadeDuration = 0;
+	// second clip while blending
+	LocalPose blendPose;
+
+	//currentClip at t blended with the fading clip and the layers at their times, into pose, returns the bones sampled
+	//skip only applies to currentClip, the callers pass it when nothing is blended
+	int blendPoseNow(const unsigned char* skip)
+	{
+		int bones = animation->bonesSize();
+		int sampled = animation->clip(currentClip)->samplePose(t, bones, pose, skip);
+		if (crossFading())
+		{
+			sampled += animation->clip(fadeClip)->samplePose(fadeT, bones, blendPose);
+			PoseBlend::lerp(blendPose, pose, fadeElapsed / fadeDuration, pose);
+		}
+		for (AnimationLayer& layer : layers)
+		{
+			if (layer.weight <= 0)
+				continue;
+			const float* mask = layer.mask ? layer.mask->data() : nullptr;
+			sampled += animation->clip(layer.clip)->samplePose(layer.t, bones, blendPose);
+			if (layer.mode == BLEND_ADDITIVE)
+				PoseBlend::additive(pose, blendPose, layer.reference, layer.weight, pose, mask);
+			else
+				PoseBlend::lerp(pose, blendPose, layer.weight, pose, mask);
+		}
+		return sampled;
+	}
+
+	bool useBaked() const
+	{
+		return baked && layers.empty() && baked->contains(currentClip) && (!crossFading() || baked->contains(fadeClip));
+	}
+
+	void updateBaked(float dt)
+	{
+		baked->sample(currentClip, t, bakedLerp, matrices);
+		if (crossFading())
+		{
+			fadeElapsed += dt;
+			fadeT = advance(fadeClip, fadeT, dt);
+			if (fadeElapsed >= fadeDuration)
+				fadeClip = INVALID_CLIP_HANDLE;
+			else
+				baked->sample(fadeClip, fadeT, bakedLerp, matrices, fadeElapsed / fadeDuration);
+		}
+		bonesSampled = 0;
+		// no globals this time, findWorldMatrix samples its chain
+		poseClip = INVALID_CLIP_HANDLE;
+	}
+
+	float advance(ClipHandle clip, float time, float dt)
+	{
+		time += dt;
+		float duration = animation->clip(clip)->duration();
+		if (time > duration)
+			time = duration > 0 ? fmodf(time, duration) : 0;
+		return time;
+	}
 };
\ No newline at end of file
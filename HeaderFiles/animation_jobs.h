@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include "animation.h"
+#include "job_system.h"
+#include "animation_lod.h"
+#include "skinning.h"
+
+//Parallel animation update
+/*
+– characters queue their clip + dt once the game logic has picked the state
+– run() evaluates every queued AnimationInstance on the job system and returns when all are done
+– each instance only writes its own pose + palette (matrices), the Animation it reads is shared and read only
+– run() joins before command recording, the draws upload the palettes as before
+– a job with an AnimationLOD goes through it (skipped frames, detail bones, frozen), stats sums them after the join
+– a job with a CpuSkinning refits its skinned bounds from the new palette on the same thread, not while frozen
+*/
+
+// instances per job are picked so every thread gets about this many chunks
+#define ANIMATION_JOB_CHUNKS_PER_THREAD 4
+
+struct AnimationJob
+{
+	AnimationInstance* instance;
+	ClipHandle clip;
+	float dt;
+	AnimationLOD* lod;
+	CpuSkinning* skinning;
+};
+
+class AnimationJobs
+{
+public:
+	std::vector<AnimationJob> jobs;
+	// counts of the last run
+	AnimationLODStats stats;
+
+	void add(AnimationInstance* instance, ClipHandle clip, float dt, AnimationLOD* lod = nullptr, CpuSkinning* skinning = nullptr)
+	{
+		jobs.push_back({ instance, clip, dt, lod, skinning });
+	}
+
+	//evaluate everything queued this frame, system == nullptr runs it on this thread
+	void run(JobSystem* system)
+	{
+		unsigned int count = (unsigned int)jobs.size();
+		unsigned int threads = system ? system->worker_count() + 1 : 1;
+		unsigned int grain = max(1u, count / (threads * ANIMATION_JOB_CHUNKS_PER_THREAD));
+		auto evaluate = [this](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				AnimationInstance* instance = jobs[i].instance;
+				if (jobs[i].lod)
+					jobs[i].lod->evaluate(instance, jobs[i].clip, jobs[i].dt);
+				else
+				{
+					instance->update(jobs[i].clip, jobs[i].dt);
+					if (instance->animationFinished())
+						instance->resetAnimationTime();
+				}
+				// a frozen palette has not moved
+				bool frozen = jobs[i].lod && jobs[i].lod->level == ANIMATION_LOD_FROZEN && !jobs[i].lod->evaluated;
+				if (jobs[i].skinning && !frozen)
+					jobs[i].skinning->update_bounds(instance->matrices, (unsigned int)instance->animation->bonesSize());
+			}
+		};
+		if (system)
+			system->parallel_for(count, grain, evaluate);
+		else
+			evaluate(0, count);
+
+		stats = AnimationLODStats();
+		for (const AnimationJob& job : jobs)
+		{
+			unsigned int bones = (unsigned int)job.instance->animation->bonesSize();
+			if (job.lod)
+			{
+				job.lod->add_stats(stats, bones);
+				continue;
+			}
+			stats.characters++;
+			stats.evaluated++;
+			stats.bones_total += bones;
+			stats.bones_evaluated += job.instance->bonesSampled;
+		}
+		jobs.clear();
+	}
+};
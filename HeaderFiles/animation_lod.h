@@ -0,0 +1,208 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cctype>
+#include <cfloat>
+#include <iostream>
+#include "vectors.h"
+#include "frustum.h"
+#include "animation.h"
+
+//Animation LOD
+/*
+– picked per character each frame from the camera distance and the frustum
+	level 0: every frame, every bone
+	level 1: every 2nd frame
+	level 2: every 3rd frame, detail bones (fingers, face, toes, twist) keep their last pose
+	level 3: every 4th frame, detail bones skipped
+	off screen: frozen, the clip time still runs so it is in the right place when it comes back
+– skipped frames interpolate the palette:
+	• an update evaluates interval frames ahead, the palette then lerps from what was shown to the new one
+	• the clip time is corrected every update so it never drifts from real time
+– detail bones are found by name, a detail bone's children are detail bones too
+*/
+
+#define ANIMATION_LOD_LEVELS 4
+#define ANIMATION_LOD_FROZEN ANIMATION_LOD_LEVELS
+// bone name parts (lower case) that count as detail bones
+#define ANIMATION_LOD_DETAIL_NAMES { "index", "middle", "pinky", "ring", "thumb", "eye", "mouth", "jaw", "ear", "toes", "ball", "twist", "hat" }
+
+struct AnimationLODLevel
+{
+	// camera distance this level is used up to
+	float distance;
+	unsigned int interval;
+	bool skip_detail;
+};
+
+struct AnimationLODStats
+{
+	unsigned int characters = 0;
+	unsigned int evaluated = 0;
+	unsigned int interpolated = 0;
+	unsigned int frozen = 0;
+	unsigned int bones_evaluated = 0;
+	// bones a full update of every character would have sampled
+	unsigned int bones_total = 0;
+
+	void print() const
+	{
+		std::cout << "animation characters: " << characters << " evaluated: " << evaluated
+			<< " interpolated: " << interpolated << " frozen: " << frozen
+			<< " bones: " << bones_evaluated << "/" << bones_total << std::endl;
+	}
+};
+
+class AnimationLOD
+{
+public:
+	AnimationLODLevel levels[ANIMATION_LOD_LEVELS] = {
+		{ 800.0f, 1, false },
+		{ 1600.0f, 2, false },
+		{ 3000.0f, 3, true },
+		{ FLT_MAX, 4, true }
+	};
+	bool enabled = true;
+	unsigned int level = 0;
+	// what the last evaluate() did, read after AnimationJobs::run
+	unsigned int bones_evaluated = 0;
+	bool evaluated = false;
+
+	//detail bones of the skeleton
+	void init(Animation* animation)
+	{
+		const Skeleton& skeleton = animation->skeleton;
+		const char* names[] = ANIMATION_LOD_DETAIL_NAMES;
+		detail.assign(skeleton.bones.size(), 0);
+		for (unsigned int i = 0; i < skeleton.bones.size(); i++)
+		{
+			std::string name = skeleton.bones[i].name;
+			for (char& c : name)
+				c = (char)tolower((unsigned char)c);
+			for (const char* part : names)
+			{
+				if (name.find(part) != std::string::npos)
+					detail[i] = 1;
+			}
+			// parents come first, children of detail bones are detail
+			int parent = skeleton.bones[i].parentIndex;
+			if (parent > -1 && detail[parent])
+				detail[i] = 1;
+		}
+		frames_since_update = 0;
+		owed = 0;
+		has_pose = false;
+	}
+
+	//main thread, before the character is queued
+	void select(const Vec3& center, float radius, const Vec3& camera_position, const Frustum& frustum)
+	{
+		if (!enabled)
+		{
+			level = 0;
+			return;
+		}
+		if (!frustum.sphere_visible(center, radius))
+		{
+			level = ANIMATION_LOD_FROZEN;
+			return;
+		}
+		float distance = (center - camera_position).length();
+		level = ANIMATION_LOD_LEVELS - 1;
+		for (unsigned int i = 0; i < ANIMATION_LOD_LEVELS; i++)
+		{
+			if (distance <= levels[i].distance)
+			{
+				level = i;
+				break;
+			}
+		}
+	}
+
+	//on the job thread, in place of instance->update(clip, dt)
+	void evaluate(AnimationInstance* instance, ClipHandle clip, float dt)
+	{
+		evaluated = false;
+		bones_evaluated = 0;
+		owed += dt;
+		unsigned int bones = (unsigned int)instance->animation->bonesSize();
+
+		if (level == ANIMATION_LOD_FROZEN && has_pose)
+		{
+			frames_since_update = 0;
+			return;
+		}
+
+		const AnimationLODLevel& settings = levels[min(level, (unsigned int)ANIMATION_LOD_LEVELS - 1)];
+		unsigned int interval = level == ANIMATION_LOD_FROZEN ? 1 : settings.interval;
+		instance->skipBones = settings.skip_detail && level != ANIMATION_LOD_FROZEN && detail.size() == bones ? detail.data() : nullptr;
+
+		if (interval <= 1 || !has_pose)
+		{
+			// plain update, nothing to interpolate, still ahead from an interpolated level -> wait
+			float step = max(owed, 0.0f);
+			instance->update(clip, step);
+			owed -= step;
+			finish(instance);
+			frames_since_update = 0;
+			return;
+		}
+
+		if (frames_since_update == 0 || frames_since_update >= step_count)
+		{
+			// from = what is on screen, to = interval frames ahead
+			from.assign(instance->matrices, instance->matrices + bones);
+			float ahead = owed + dt * (interval - 1);
+			instance->update(clip, ahead);
+			owed -= ahead;
+			finish(instance);
+			to.assign(instance->matrices, instance->matrices + bones);
+			step_count = interval;
+			frames_since_update = 0;
+		}
+
+		frames_since_update++;
+		float blend = (float)frames_since_update / (float)step_count;
+		for (unsigned int i = 0; i < bones; i++)
+		{
+			for (unsigned int k = 0; k < 16; k++)
+				instance->matrices[i].m[k] = from[i].m[k] + (to[i].m[k] - from[i].m[k]) * blend;
+		}
+		if (frames_since_update >= step_count)
+			frames_since_update = 0;
+	}
+
+	void add_stats(AnimationLODStats& stats, unsigned int bones) const
+	{
+		stats.characters++;
+		stats.bones_total += bones;
+		stats.bones_evaluated += bones_evaluated;
+		if (evaluated)
+			stats.evaluated++;
+		else if (level == ANIMATION_LOD_FROZEN)
+			stats.frozen++;
+		else
+			stats.interpolated++;
+	}
+
+private:
+	std::vector<unsigned char> detail;
+	// palettes the skipped frames lerp between
+	std::vector<Matrix> from;
+	std::vector<Matrix> to;
+	unsigned int frames_since_update = 0;
+	unsigned int step_count = 1;
+	// real time not yet given to the instance, negative while it is ahead
+	float owed = 0;
+	bool has_pose = false;
+
+	void finish(AnimationInstance* instance)
+	{
+		instance->skipBones = nullptr;
+		if (instance->animationFinished())
+			instance->resetAnimationTime();
+		bones_evaluated = instance->bonesSampled;
+		evaluated = true;
+		has_pose = true;
+	}
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include "job_system.h"
+#include "textureloader.h"
+#include "mesh.h"
+#include "loadfiles.h"
+#include "gem_cooked.h"
+#include "model_registry.h"
+
+//Startup asset loading
+/*
+– everything that does not need the device runs on the job system: the .gemc check (cooking on a miss), PNG decode, instance files
+– a model job queues its textures as soon as the .gemc gives their names, a file is only read once however often it is asked for
+– wait() joins, then the main thread runs the usual init calls and they only upload:
+	• decoded textures go to Texture_Manager::decoded, Texture::load takes them from there
+	• instance matrices are handed over by take_instances()
+	• the opened .gemc of each model goes to the ModelRegistry, the inits neither map nor hash the .gem again
+– every job and every upload is on the timeline, report() prints it per asset
+*/
+
+struct AssetEvent
+{
+	std::string name;
+	std::string kind;
+	// 0 = main thread
+	unsigned int thread;
+	double start_ms;
+	double end_ms;
+};
+
+class AssetLoader
+{
+public:
+	std::vector<AssetEvent> timeline;
+
+	//jobs == nullptr loads everything on this thread
+	void init(JobSystem* _jobs)
+	{
+		jobs = _jobs;
+		start = std::chrono::high_resolution_clock::now();
+		last_upload = start;
+		threads.clear();
+		threads[std::this_thread::get_id()] = 0;
+	}
+
+	//Models/<name>.gem, + its textures
+	void model(const std::string& name)
+	{
+		std::string filename = "Models/" + name + ".gem";
+		if (!request(filename))
+			return;
+		run([this, name, filename]()
+		{
+			double begin = now();
+			GEMCookedModel cooked;
+			if (load_cooked_gem(filename, cooked))
+			{
+				for (unsigned int i = 0; i < cooked.mesh_count(); i++)
+				{
+					for (unsigned int k = 0; k < GEM_COOKED_TEXTURES; k++)
+					{
+						std::string texture_name = cooked.texture(i, k);
+						if (!texture_name.empty())
+							texture(texture_name);
+					}
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				models[filename].swap(cooked);
+			}
+			record(name, "model", begin);
+		});
+	}
+
+	void texture(const std::string& filename)
+	{
+		if (!request(filename))
+			return;
+		run([this, filename]()
+		{
+			double begin = now();
+			TextureImage image;
+			Texture::decode(filename, image);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				images[filename] = std::move(image);
+			}
+			record(filename, "texture", begin);
+		});
+	}
+
+	void instances(const std::string& filename)
+	{
+		if (!request(filename))
+			return;
+		run([this, filename]()
+		{
+			double begin = now();
+			std::vector<INSTANCE> matrices;
+			load_instance_matrices(filename, matrices);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				instance_files[filename] = std::move(matrices);
+			}
+			record(filename, "instances", begin);
+		});
+	}
+
+	//blocks until every queued file is read, the decoded textures move to the texture manager, the opened models to the registry
+	void wait(Texture_Manager* textures)
+	{
+		if (jobs)
+			jobs->wait(group);
+		for (auto& image : images)
+			textures->decoded[image.first] = std::move(image.second);
+		images.clear();
+		for (auto& model : models)
+			ModelRegistry::get().add_opened(model.first, model.second);
+		models.clear();
+		last_upload = std::chrono::high_resolution_clock::now();
+	}
+
+	bool take_instances(const std::string& filename, std::vector<INSTANCE>& out)
+	{
+		auto found = instance_files.find(filename);
+		if (found == instance_files.end())
+			return false;
+		out = std::move(found->second);
+		instance_files.erase(found);
+		return true;
+	}
+
+	//main thread, call after each init: the time since the last call is the upload of name
+	void uploaded(const std::string& name)
+	{
+		double begin = std::chrono::duration<double, std::milli>(last_upload - start).count();
+		last_upload = std::chrono::high_resolution_clock::now();
+		timeline.push_back({ name, "upload", 0, begin, now() });
+	}
+
+	void report() const
+	{
+		std::vector<AssetEvent> events = timeline;
+		std::sort(events.begin(), events.end(), [](const AssetEvent& a, const AssetEvent& b) { return a.start_ms < b.start_ms; });
+		double loading = 0;
+		double loading_sum = 0;
+		double uploading = 0;
+		const AssetEvent* longest = nullptr;
+		std::cout << "Startup timeline (ms, thread 0 = main):" << std::endl;
+		for (const AssetEvent& e : events)
+		{
+			std::cout << "  " << e.start_ms << " - " << e.end_ms << "  (" << e.end_ms - e.start_ms << ")  thread " << e.thread
+				<< "  " << e.kind << "  " << e.name << std::endl;
+			if (e.kind == "upload")
+			{
+				uploading += e.end_ms - e.start_ms;
+				continue;
+			}
+			loading = max(loading, e.end_ms);
+			loading_sum += e.end_ms - e.start_ms;
+			if (!longest || e.end_ms - e.start_ms > longest->end_ms - longest->start_ms)
+				longest = &e;
+		}
+		std::cout << "  loading: " << loading << " ms on " << threads.size() << " threads, " << loading_sum << " ms one after another";
+		if (longest)
+			std::cout << ", longest " << longest->name << " " << longest->end_ms - longest->start_ms << " ms";
+		std::cout << std::endl;
+		std::cout << "  uploads on the main thread: " << uploading << " ms" << std::endl;
+	}
+
+private:
+	JobSystem* jobs = nullptr;
+	// the startup files, wait() joins only these
+	JobGroup group;
+	std::mutex mutex;
+	std::chrono::high_resolution_clock::time_point start;
+	std::chrono::high_resolution_clock::time_point last_upload;
+	std::unordered_map<std::thread::id, unsigned int> threads;
+	std::unordered_set<std::string> requested;
+	std::unordered_map<std::string, TextureImage> images;
+	std::unordered_map<std::string, GEMCookedModel> models;
+	std::unordered_map<std::string, std::vector<INSTANCE>> instance_files;
+
+	double now() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//false when the file is already queued
+	bool request(const std::string& filename)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return requested.insert(filename).second;
+	}
+
+	template<typename FUNC>
+	void run(FUNC func)
+	{
+		if (jobs)
+			jobs->submit(func, &group);
+		else
+			func();
+	}
+
+	void record(const std::string& name, const char* kind, double begin)
+	{
+		double end = now();
+		std::lock_guard<std::mutex> lock(mutex);
+		auto thread = threads.insert({ std::this_thread::get_id(), (unsigned int)threads.size() }).first;
+		timeline.push_back({ name, kind, thread->second, begin, end });
+	}
+};
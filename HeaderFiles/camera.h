@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "vectors.h"
+#include "frustum.h"
 #include "window.h"
 
 class Camera
@@ -19,6 +20,8 @@ public:
     Matrix view;
     Matrix projection;
     Matrix view_projection;
+    // world space planes of view_projection, for CPU culling
+    Frustum frustum;
 
     float speed;
     float mouse_sensitivity;
@@ -102,6 +105,7 @@ public:
         view = Matrix::lookAt(position, target, up);
         projection = Matrix::perspective(fov, aspect, near_plane, far_plane);
         view_projection = projection.mul(view);
+        frustum.extract(view_projection);
 
     }
     void update_vectors()
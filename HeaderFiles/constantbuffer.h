@@ -78,6 +78,16 @@ public:
 		}
 	}
 
+	//only the first dataSize bytes of the variable, e.g. the bones a skeleton actually has
+	void update(const std::string& name, const void* data, unsigned int dataSize)
+	{
+		auto it = constantBufferData.find(name);
+		if (it == constantBufferData.end())
+			return;
+		unsigned int offset = offsetIndex * cbSizeInBytes;
+		memcpy(&buffer[offset + it->second.offset], data, min(dataSize, it->second.size));
+	}
+
 	void updateBuffer(const void* data, unsigned int dataSize)
 	{
 		if (!buffer) {
@@ -0,0 +1,82 @@
+#pragma once
+#include "vectors.h"
+
+//View frustum
+/*
+– 6 planes pulled straight out of the view projection matrix (Gribb/Hartmann)
+– clip = VP * p, a point is inside when -w <= x,y <= w and 0 <= z <= w (D3D depth)
+– plane = (a, b, c, d), inside when a*x + b*y + c*z + d >= 0
+– planes are normalised so the distance can be compared with a sphere radius
+*/
+
+enum Frustum_Plane
+{
+	FRUSTUM_LEFT = 0,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+class Frustum
+{
+public:
+	Vec4 planes[FRUSTUM_PLANE_COUNT];
+
+	void extract(const Matrix& vp)
+	{
+		const float* r0 = vp.a[0];
+		const float* r1 = vp.a[1];
+		const float* r2 = vp.a[2];
+		const float* r3 = vp.a[3];
+
+		planes[FRUSTUM_LEFT] = Vec4(r3[0] + r0[0], r3[1] + r0[1], r3[2] + r0[2], r3[3] + r0[3]);
+		planes[FRUSTUM_RIGHT] = Vec4(r3[0] - r0[0], r3[1] - r0[1], r3[2] - r0[2], r3[3] - r0[3]);
+		planes[FRUSTUM_BOTTOM] = Vec4(r3[0] + r1[0], r3[1] + r1[1], r3[2] + r1[2], r3[3] + r1[3]);
+		planes[FRUSTUM_TOP] = Vec4(r3[0] - r1[0], r3[1] - r1[1], r3[2] - r1[2], r3[3] - r1[3]);
+		planes[FRUSTUM_NEAR] = Vec4(r2[0], r2[1], r2[2], r2[3]);
+		planes[FRUSTUM_FAR] = Vec4(r3[0] - r2[0], r3[1] - r2[1], r3[2] - r2[2], r3[3] - r2[3]);
+
+		for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+		{
+			float len = sqrtf(SQ(planes[i].x) + SQ(planes[i].y) + SQ(planes[i].z));
+			if (len > 0)
+			{
+				float inv = 1.0f / len;
+				planes[i] = Vec4(planes[i].x * inv, planes[i].y * inv, planes[i].z * inv, planes[i].w * inv);
+			}
+		}
+	}
+
+	float distance(int plane, const Vec3& p) const
+	{
+		return planes[plane].x * p.x + planes[plane].y * p.y + planes[plane].z * p.z + planes[plane].w;
+	}
+
+	// false only when the sphere is fully outside one plane
+	bool sphere_visible(const Vec3& center, float radius) const
+	{
+		for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+		{
+			if (distance(i, center) < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	// p-vertex test, false only when the box is fully outside one plane
+	bool aabb_visible(const Vec3& box_min, const Vec3& box_max) const
+	{
+		for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+		{
+			Vec3 p(planes[i].x >= 0 ? box_max.x : box_min.x,
+				planes[i].y >= 0 ? box_max.y : box_min.y,
+				planes[i].z >= 0 ? box_max.z : box_min.z);
+			if (distance(i, p) < 0)
+				return false;
+		}
+		return true;
+	}
+};
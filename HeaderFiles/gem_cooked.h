@@ -0,0 +1,437 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "vectors.h"
+#include "vertexLayoutCache.h"
+#include "animation.h"
+#include "gem_mapped.h"
+
+//Cooked model cache (.gemc)
+/*
+– what init_meshes and load_gem_animation work out from a .gem every start, stored once in the form the engine uses:
+	• per mesh: welded + reordered vertices in STATIC_VERTEX / ANIMATED_VERTEX layout, 32 bit indices, the albedo / nh / rmax paths
+	• the model bounds for the hitbox
+	• the skeleton and every clip already packed (PackedClip bone table + keyframe buffer)
+– one blob: header, mesh / bone / clip tables, then the arrays, each array starts on a 16 byte boundary
+– open() maps the file, checks the header and that every table and array is inside it, then the arrays are used in place
+	nothing is looked at per vertex, index or keyframe, the contents are trusted as the cooker wrote them
+	Mesh::init uploads the vertices and indices straight from the mapping
+– the header keeps a hash + the size of the source .gem, the format + cooker versions and the vertex / track sizes
+	if any of them differ the .gemc is stale and gets cooked again
+– GEM_COOKER_VERSION has to go up with any change to what the cooking steps give (MeshOptimizer, clip packing, bounds, material parsing)
+	a changed cooker over an unchanged .gem would otherwise keep loading the old output
+*/
+
+#define GEM_COOKED_SIGNATURE 0x434D4547u
+// layout of the file
+#define GEM_COOKED_VERSION 2
+// output of cook_gem, see above
+#define GEM_COOKER_VERSION 1
+#define GEM_COOKED_ALIGNMENT 16
+#define GEM_COOKED_EXTENSION ".gemc"
+// albedo, nh, rmax
+#define GEM_COOKED_TEXTURES 3
+
+struct GEMCookedString
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t pad;
+};
+
+struct GEMCookedHeader
+{
+	uint32_t signature;
+	uint32_t version;
+	uint32_t cooker_version;
+	uint32_t pad;
+	uint64_t source_hash;
+	uint64_t source_size;
+	uint32_t animated;
+	uint32_t vertex_size;
+	uint32_t track_size;
+	uint32_t mesh_count;
+	uint32_t bone_count;
+	uint32_t clip_count;
+	// offsets of the mesh, bone and clip tables
+	uint64_t meshes;
+	uint64_t bones;
+	uint64_t clips;
+	float bounds_min[3];
+	float bounds_max[3];
+	float global_inverse[16];
+};
+
+struct GEMCookedMesh
+{
+	uint64_t vertices;
+	uint64_t indices;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	GEMCookedString textures[GEM_COOKED_TEXTURES];
+};
+
+struct GEMCookedBone
+{
+	GEMCookedString name;
+	float offset[16];
+	int32_t parent_index;
+	uint32_t pad[3];
+};
+
+struct GEMCookedClip
+{
+	GEMCookedString name;
+	// PackedBoneTracks[bone_count], unsigned short[frame_count * stride]
+	uint64_t tracks;
+	uint64_t keyframes;
+	uint32_t bone_count;
+	uint32_t frame_count;
+	uint32_t stride;
+	float ticks_per_second;
+};
+
+//the source .gem read 8 bytes at a time, only has to tell a changed file from the one that was cooked
+static uint64_t gem_source_hash(const char* data, size_t bytes)
+{
+	uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t)bytes;
+	size_t i = 0;
+	for (; i + 8 <= bytes; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ word) * 0x100000001b3ull;
+		h ^= h >> 29;
+	}
+	for (; i < bytes; i++)
+		h = (h ^ (unsigned char)data[i]) * 0x100000001b3ull;
+	return h;
+}
+
+class GEMCookedWriter
+{
+public:
+	std::vector<char> blob;
+
+	//header + empty tables, the tables are filled by set_mesh / set_skeleton / set_clip
+	void begin(bool animated, uint64_t source_hash, uint64_t source_size, unsigned int mesh_count, unsigned int bone_count, unsigned int clip_count)
+	{
+		blob.clear();
+		add(nullptr, sizeof(GEMCookedHeader));
+		uint64_t meshes = add(nullptr, sizeof(GEMCookedMesh) * mesh_count);
+		uint64_t bones = add(nullptr, sizeof(GEMCookedBone) * bone_count);
+		uint64_t clips = add(nullptr, sizeof(GEMCookedClip) * clip_count);
+		GEMCookedHeader& h = header();
+		h.signature = GEM_COOKED_SIGNATURE;
+		h.version = GEM_COOKED_VERSION;
+		h.cooker_version = GEM_COOKER_VERSION;
+		h.source_hash = source_hash;
+		h.source_size = source_size;
+		h.animated = animated ? 1 : 0;
+		h.vertex_size = animated ? sizeof(ANIMATED_VERTEX) : sizeof(STATIC_VERTEX);
+		h.track_size = sizeof(PackedBoneTracks);
+		h.mesh_count = mesh_count;
+		h.bone_count = bone_count;
+		h.clip_count = clip_count;
+		h.meshes = meshes;
+		h.bones = bones;
+		h.clips = clips;
+		Matrix identity;
+		memcpy(h.global_inverse, identity.m, sizeof(h.global_inverse));
+	}
+
+	//vertices in the header's layout
+	void set_mesh(unsigned int i, const void* vertices, unsigned int vertex_count, const std::vector<unsigned int>& indices, const std::string textures[GEM_COOKED_TEXTURES])
+	{
+		uint64_t v = add(vertices, (size_t)vertex_count * header().vertex_size);
+		uint64_t ix = add(indices.data(), indices.size() * sizeof(unsigned int));
+		GEMCookedString t[GEM_COOKED_TEXTURES];
+		for (unsigned int k = 0; k < GEM_COOKED_TEXTURES; k++)
+			t[k] = add_string(textures[k]);
+		GEMCookedMesh& mesh = table<GEMCookedMesh>(header().meshes)[i];
+		mesh.vertices = v;
+		mesh.indices = ix;
+		mesh.vertex_count = vertex_count;
+		mesh.index_count = (uint32_t)indices.size();
+		for (unsigned int k = 0; k < GEM_COOKED_TEXTURES; k++)
+			mesh.textures[k] = t[k];
+	}
+
+	void set_bounds(const Vec3& bounds_min, const Vec3& bounds_max)
+	{
+		memcpy(header().bounds_min, bounds_min.v, sizeof(float) * 3);
+		memcpy(header().bounds_max, bounds_max.v, sizeof(float) * 3);
+	}
+
+	void set_skeleton(const Skeleton& skeleton)
+	{
+		memcpy(header().global_inverse, skeleton.globalInverse.m, sizeof(float) * 16);
+		for (unsigned int i = 0; i < skeleton.bones.size(); i++)
+		{
+			GEMCookedString name = add_string(skeleton.bones[i].name);
+			GEMCookedBone& bone = table<GEMCookedBone>(header().bones)[i];
+			bone.name = name;
+			memcpy(bone.offset, skeleton.bones[i].offset.m, sizeof(float) * 16);
+			bone.parent_index = skeleton.bones[i].parentIndex;
+		}
+	}
+
+	//a packed clip, an unpacked one is packed first by the caller
+	void set_clip(unsigned int i, const std::string& name, const AnimationSequence& sequence)
+	{
+		const PackedClip& packed = sequence.packed;
+		GEMCookedString n = add_string(name);
+		uint64_t tracks = add(packed.bones.data(), packed.bones.size() * sizeof(PackedBoneTracks));
+		uint64_t keyframes = add(packed.data.data(), packed.data.size() * sizeof(unsigned short));
+		GEMCookedClip& clip = table<GEMCookedClip>(header().clips)[i];
+		clip.name = n;
+		clip.tracks = tracks;
+		clip.keyframes = keyframes;
+		clip.bone_count = (uint32_t)packed.bones.size();
+		clip.frame_count = packed.frame_count;
+		clip.stride = packed.stride;
+		clip.ticks_per_second = sequence.ticksPerSecond;
+	}
+
+private:
+	GEMCookedHeader& header()
+	{
+		return *reinterpret_cast<GEMCookedHeader*>(blob.data());
+	}
+
+	template<typename T>
+	T* table(uint64_t offset)
+	{
+		return reinterpret_cast<T*>(blob.data() + offset);
+	}
+
+	//append at the next aligned offset, zeros when data is null, blob may move
+	uint64_t add(const void* data, size_t size)
+	{
+		size_t offset = (blob.size() + GEM_COOKED_ALIGNMENT - 1) & ~(size_t)(GEM_COOKED_ALIGNMENT - 1);
+		blob.resize(offset + size, 0);
+		if (data && size)
+			memcpy(blob.data() + offset, data, size);
+		return offset;
+	}
+
+	GEMCookedString add_string(const std::string& s)
+	{
+		GEMCookedString out = {};
+		out.offset = add(s.data(), s.size());
+		out.length = (uint32_t)s.size();
+		return out;
+	}
+};
+
+class GEMCookedModel
+{
+public:
+	const GEMCookedHeader* header = nullptr;
+
+	GEMCookedModel() {}
+	~GEMCookedModel()
+	{
+		close();
+	}
+	GEMCookedModel(const GEMCookedModel&) = delete;
+	GEMCookedModel& operator=(const GEMCookedModel&) = delete;
+
+	//map a .gemc, false (quietly) when it is missing, stale or broken
+	bool open(const std::string& filename, uint64_t source_hash, uint64_t source_size)
+	{
+		close();
+		if (!file.open(filename))
+			return false;
+		return use(file.data(), file.size(), source_hash, source_size);
+	}
+
+	//a blob that was just cooked, it is kept here
+	bool open(std::vector<char>&& blob, uint64_t source_hash, uint64_t source_size)
+	{
+		close();
+		owned.swap(blob);
+		return use(owned.data(), owned.size(), source_hash, source_size);
+	}
+
+	void close()
+	{
+		file.close();
+		std::vector<char>().swap(owned);
+		header = nullptr;
+		base = nullptr;
+		bytes = 0;
+	}
+
+	bool is_open() const
+	{
+		return header != nullptr;
+	}
+
+	//an opened model changes owner (AssetLoader -> ModelRegistry), nothing is mapped or read again
+	void swap(GEMCookedModel& other)
+	{
+		file.swap(other.file);
+		owned.swap(other.owned);
+		std::swap(header, other.header);
+		std::swap(base, other.base);
+		std::swap(bytes, other.bytes);
+	}
+
+	bool animated() const
+	{
+		return header->animated != 0;
+	}
+
+	unsigned int mesh_count() const
+	{
+		return header->mesh_count;
+	}
+
+	const GEMCookedMesh& mesh(unsigned int i) const
+	{
+		return at<GEMCookedMesh>(header->meshes)[i];
+	}
+
+	GEMSpan<STATIC_VERTEX> vertices_static(unsigned int i) const
+	{
+		return span<STATIC_VERTEX>(mesh(i).vertices, animated() ? 0 : mesh(i).vertex_count);
+	}
+
+	GEMSpan<ANIMATED_VERTEX> vertices_animated(unsigned int i) const
+	{
+		return span<ANIMATED_VERTEX>(mesh(i).vertices, animated() ? mesh(i).vertex_count : 0);
+	}
+
+	GEMSpan<unsigned int> indices(unsigned int i) const
+	{
+		return span<unsigned int>(mesh(i).indices, mesh(i).index_count);
+	}
+
+	//0 albedo, 1 nh, 2 rmax
+	std::string texture(unsigned int i, unsigned int k) const
+	{
+		return str(mesh(i).textures[k]);
+	}
+
+	Vec3 bounds_min() const
+	{
+		return Vec3(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]);
+	}
+
+	Vec3 bounds_max() const
+	{
+		return Vec3(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]);
+	}
+
+	unsigned int bone_count() const
+	{
+		return header->bone_count;
+	}
+
+	const GEMCookedBone& bone(unsigned int i) const
+	{
+		return at<GEMCookedBone>(header->bones)[i];
+	}
+
+	unsigned int clip_count() const
+	{
+		return header->clip_count;
+	}
+
+	const GEMCookedClip& clip(unsigned int i) const
+	{
+		return at<GEMCookedClip>(header->clips)[i];
+	}
+
+	GEMSpan<PackedBoneTracks> tracks(unsigned int i) const
+	{
+		return span<PackedBoneTracks>(clip(i).tracks, clip(i).bone_count);
+	}
+
+	GEMSpan<unsigned short> keyframes(unsigned int i) const
+	{
+		return span<unsigned short>(clip(i).keyframes, clip(i).frame_count * clip(i).stride);
+	}
+
+	std::string str(const GEMCookedString& s) const
+	{
+		return std::string(base + s.offset, s.length);
+	}
+
+private:
+	GEMFileMapping file;
+	std::vector<char> owned;
+	const char* base = nullptr;
+	size_t bytes = 0;
+
+	template<typename T>
+	const T* at(uint64_t offset) const
+	{
+		return reinterpret_cast<const T*>(base + offset);
+	}
+
+	template<typename T>
+	GEMSpan<T> span(uint64_t offset, unsigned int count) const
+	{
+		GEMSpan<T> s;
+		s.data = at<T>(offset);
+		s.count = count;
+		return s;
+	}
+
+	//offset is aligned and count * size bytes from it are inside the blob
+	bool inside(uint64_t offset, uint64_t count, uint64_t size) const
+	{
+		if (offset % GEM_COOKED_ALIGNMENT != 0 || offset > bytes)
+			return false;
+		return size == 0 || count <= (bytes - offset) / size;
+	}
+
+	bool use(const char* data, size_t size, uint64_t source_hash, uint64_t source_size)
+	{
+		base = data;
+		bytes = size;
+		const GEMCookedHeader* h = at<GEMCookedHeader>(0);
+		bool valid = size >= sizeof(GEMCookedHeader)
+			&& h->signature == GEM_COOKED_SIGNATURE
+			&& h->version == GEM_COOKED_VERSION
+			&& h->cooker_version == GEM_COOKER_VERSION
+			&& h->source_hash == source_hash
+			&& h->source_size == source_size
+			&& h->vertex_size == (h->animated ? sizeof(ANIMATED_VERTEX) : sizeof(STATIC_VERTEX))
+			&& h->track_size == sizeof(PackedBoneTracks)
+			&& inside(h->meshes, h->mesh_count, sizeof(GEMCookedMesh))
+			&& inside(h->bones, h->bone_count, sizeof(GEMCookedBone))
+			&& inside(h->clips, h->clip_count, sizeof(GEMCookedClip));
+		for (unsigned int i = 0; valid && i < h->mesh_count; i++)
+		{
+			const GEMCookedMesh& m = at<GEMCookedMesh>(h->meshes)[i];
+			valid = inside(m.vertices, m.vertex_count, h->vertex_size) && inside(m.indices, m.index_count, sizeof(unsigned int));
+			for (unsigned int k = 0; valid && k < GEM_COOKED_TEXTURES; k++)
+				valid = inside(m.textures[k].offset, m.textures[k].length, 1);
+		}
+		for (unsigned int i = 0; valid && i < h->bone_count; i++)
+		{
+			const GEMCookedBone& b = at<GEMCookedBone>(h->bones)[i];
+			valid = inside(b.name.offset, b.name.length, 1) && b.parent_index < (int32_t)h->bone_count;
+		}
+		for (unsigned int i = 0; valid && i < h->clip_count; i++)
+		{
+			const GEMCookedClip& c = at<GEMCookedClip>(h->clips)[i];
+			valid = inside(c.name.offset, c.name.length, 1) && (c.bone_count == h->bone_count || c.frame_count == 0)
+				&& inside(c.tracks, c.bone_count, sizeof(PackedBoneTracks))
+				&& inside(c.keyframes, (uint64_t)c.frame_count * c.stride, sizeof(unsigned short));
+		}
+		if (!valid)
+		{
+			close();
+			return false;
+		}
+		header = h;
+		return true;
+	}
+};
@@ -0,0 +1,476 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "GEMLoader.h"
+
+//Mapped GEM loader
+/*
+– the whole .gem is mapped read only, open() reads nothing itself and copies nothing
+– open() walks the file once:
+	• the signature, then every count is checked against the bytes that are left before it is used
+	• meshes, bones and clips keep where their arrays start, the vertices, indices and keyframes are spans into the mapping
+– the spans are valid while the GEMMappedModel stays open, the pages come in as they are touched
+– copy_to() / to_vector() copy, only when the caller asks for owned GEMLoader data
+– arrays come after length prefixed strings so they are not aligned, x86/x64 read unaligned floats fine
+– GEMFileMapping is the mapping on its own, the cooked .gemc files are opened with it too
+*/
+
+#define GEM_SIGNATURE 4058972161u
+
+//a whole file mapped read only
+class GEMFileMapping
+{
+public:
+	GEMFileMapping() {}
+	~GEMFileMapping()
+	{
+		close();
+	}
+	GEMFileMapping(const GEMFileMapping&) = delete;
+	GEMFileMapping& operator=(const GEMFileMapping&) = delete;
+
+	bool open(const std::string& filename)
+	{
+		close();
+		if (map(filename))
+			return true;
+		close();
+		return false;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (base)
+			UnmapViewOfFile(base);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (base)
+			munmap((void*)base, bytes);
+#endif
+		base = nullptr;
+		bytes = 0;
+	}
+
+	const char* data() const
+	{
+		return base;
+	}
+
+	size_t size() const
+	{
+		return bytes;
+	}
+
+	//the mapping changes owner, the pointers into it stay valid
+	void swap(GEMFileMapping& other)
+	{
+		std::swap(base, other.base);
+		std::swap(bytes, other.bytes);
+#ifdef _WIN32
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+#endif
+	}
+
+private:
+	const char* base = nullptr;
+	size_t bytes = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	bool map(const std::string& filename)
+	{
+#ifdef _WIN32
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER file_size;
+		// an empty file cannot be mapped, it is not a model either
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+			return false;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			return false;
+		base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		bytes = (size_t)file_size.QuadPart;
+		return base != nullptr;
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED)
+			return false;
+		base = (const char*)view;
+		bytes = (size_t)st.st_size;
+		return true;
+#endif
+	}
+};
+
+template<typename T>
+struct GEMSpan
+{
+	const T* data = nullptr;
+	unsigned int count = 0;
+
+	const T* begin() const
+	{
+		return data;
+	}
+	const T* end() const
+	{
+		return data + count;
+	}
+	unsigned int size() const
+	{
+		return count;
+	}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	const T& operator[](unsigned int i) const
+	{
+		return data[i];
+	}
+	std::vector<T> to_vector() const
+	{
+		return std::vector<T>(data, data + count);
+	}
+};
+
+struct GEMMappedString
+{
+	const char* data = nullptr;
+	unsigned int length = 0;
+
+	std::string str() const
+	{
+		// the ifstream loader stops at the first 0 too
+		return std::string(data, strnlen(data, length));
+	}
+	bool equals(const char* s) const
+	{
+		return strlen(s) == length && memcmp(data, s, length) == 0;
+	}
+};
+
+struct GEMMappedProperty
+{
+	GEMMappedString name;
+	GEMMappedString value;
+};
+
+struct GEMMappedMesh
+{
+	std::vector<GEMMappedProperty> properties;
+	GEMSpan<GEMLoader::GEMStaticVertex> vertices_static;
+	GEMSpan<GEMLoader::GEMAnimatedVertex> vertices_animated;
+	GEMSpan<unsigned int> indices;
+
+	bool is_animated() const
+	{
+		return !vertices_animated.empty();
+	}
+
+	//material value by name, "" when it is missing (GEMMaterial::find(name).getValue())
+	std::string find(const char* name) const
+	{
+		for (const GEMMappedProperty& p : properties)
+		{
+			if (p.name.equals(name))
+				return p.value.str();
+		}
+		return "";
+	}
+
+	void copy_to(GEMLoader::GEMMesh& mesh) const
+	{
+		for (const GEMMappedProperty& p : properties)
+		{
+			GEMLoader::GEMProperty property(p.name.str());
+			property.value = p.value.str();
+			mesh.material.properties.push_back(property);
+		}
+		mesh.verticesStatic = vertices_static.to_vector();
+		mesh.verticesAnimated = vertices_animated.to_vector();
+		mesh.indices = indices.to_vector();
+	}
+};
+
+struct GEMMappedBone
+{
+	GEMMappedString name;
+	const GEMLoader::GEMMatrix* offset = nullptr;
+	int parent_index = -1;
+};
+
+struct GEMMappedClip
+{
+	GEMMappedString name;
+	unsigned int frames = 0;
+	float ticks_per_second = 0;
+	unsigned int bones = 0;
+	// per frame: bones positions, bones rotations, bones scales
+	const char* keyframes = nullptr;
+
+	GEMSpan<GEMLoader::GEMVec3> positions(unsigned int frame) const
+	{
+		return span<GEMLoader::GEMVec3>(frame, 0);
+	}
+	GEMSpan<GEMLoader::GEMQuaternion> rotations(unsigned int frame) const
+	{
+		return span<GEMLoader::GEMQuaternion>(frame, bones * sizeof(GEMLoader::GEMVec3));
+	}
+	GEMSpan<GEMLoader::GEMVec3> scales(unsigned int frame) const
+	{
+		return span<GEMLoader::GEMVec3>(frame, bones * (sizeof(GEMLoader::GEMVec3) + sizeof(GEMLoader::GEMQuaternion)));
+	}
+
+	static size_t frame_bytes(unsigned int bones)
+	{
+		return (size_t)bones * (2 * sizeof(GEMLoader::GEMVec3) + sizeof(GEMLoader::GEMQuaternion));
+	}
+
+	void copy_to(GEMLoader::GEMAnimationSequence& sequence) const
+	{
+		sequence.name = name.str();
+		sequence.ticksPerSecond = ticks_per_second;
+		sequence.frames.resize(frames);
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			sequence.frames[f].positions = positions(f).to_vector();
+			sequence.frames[f].rotations = rotations(f).to_vector();
+			sequence.frames[f].scales = scales(f).to_vector();
+		}
+	}
+
+private:
+	template<typename T>
+	GEMSpan<T> span(unsigned int frame, size_t offset) const
+	{
+		GEMSpan<T> s;
+		s.data = reinterpret_cast<const T*>(keyframes + frame * frame_bytes(bones) + offset);
+		s.count = bones;
+		return s;
+	}
+};
+
+class GEMMappedModel
+{
+public:
+	std::vector<GEMMappedMesh> meshes;
+	std::vector<GEMMappedBone> bones;
+	std::vector<GEMMappedClip> clips;
+	GEMLoader::GEMMatrix global_inverse = {};
+	bool animated = false;
+
+	GEMMappedModel() {}
+	~GEMMappedModel()
+	{
+		close();
+	}
+	GEMMappedModel(const GEMMappedModel&) = delete;
+	GEMMappedModel& operator=(const GEMMappedModel&) = delete;
+
+	//map the file and index it, false (and closed) when it is missing or not a valid .gem
+	bool open(const std::string& filename)
+	{
+		close();
+		if (!file.open(filename))
+		{
+			std::cerr << "Failed to map model file: " << filename << std::endl;
+			return false;
+		}
+		base = file.data();
+		bytes = file.size();
+		size_t at = 0;
+		if (!parse(at))
+		{
+			std::cerr << filename << " is not a valid GE Model File (stopped at byte " << at << ")" << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		meshes.clear();
+		bones.clear();
+		clips.clear();
+		animated = false;
+		file.close();
+		base = nullptr;
+		bytes = 0;
+	}
+
+	bool is_open() const
+	{
+		return base != nullptr;
+	}
+
+	//the raw file
+	const char* data() const
+	{
+		return base;
+	}
+
+	size_t size() const
+	{
+		return bytes;
+	}
+
+	//owned copies in the form GEMModelLoader::load fills
+	void copy_to(std::vector<GEMLoader::GEMMesh>& out_meshes, GEMLoader::GEMAnimation& animation) const
+	{
+		out_meshes.resize(meshes.size());
+		for (size_t i = 0; i < meshes.size(); i++)
+			meshes[i].copy_to(out_meshes[i]);
+		animation.bones.resize(bones.size());
+		for (size_t i = 0; i < bones.size(); i++)
+		{
+			animation.bones[i].name = bones[i].name.str();
+			memcpy(&animation.bones[i].offset, bones[i].offset, sizeof(GEMLoader::GEMMatrix));
+			animation.bones[i].parentIndex = bones[i].parent_index;
+		}
+		animation.globalInverse = global_inverse;
+		animation.animations.resize(clips.size());
+		for (size_t i = 0; i < clips.size(); i++)
+			clips[i].copy_to(animation.animations[i]);
+	}
+
+private:
+	GEMFileMapping file;
+	const char* base = nullptr;
+	size_t bytes = 0;
+
+	bool read(size_t& at, void* out, size_t size) const
+	{
+		if (size > bytes - at)
+			return false;
+		memcpy(out, base + at, size);
+		at += size;
+		return true;
+	}
+
+	//count T's from at, the count is checked against what is left so it cannot overflow
+	template<typename T>
+	bool read_span(size_t& at, unsigned int count, GEMSpan<T>& out) const
+	{
+		if (count > (bytes - at) / sizeof(T))
+			return false;
+		out.data = reinterpret_cast<const T*>(base + at);
+		out.count = count;
+		at += (size_t)count * sizeof(T);
+		return true;
+	}
+
+	bool read_string(size_t& at, GEMMappedString& out) const
+	{
+		int length = 0;
+		if (!read(at, &length, sizeof(int)) || length < 0 || (size_t)length > bytes - at)
+			return false;
+		out.data = base + at;
+		out.length = (unsigned int)length;
+		at += length;
+		return true;
+	}
+
+	bool parse(size_t& at)
+	{
+		unsigned int signature = 0;
+		unsigned int is_animated = 0;
+		unsigned int n = 0;
+		if (!read(at, &signature, sizeof(unsigned int)) || signature != GEM_SIGNATURE)
+			return false;
+		if (!read(at, &is_animated, sizeof(unsigned int)) || !read(at, &n, sizeof(unsigned int)))
+			return false;
+		animated = is_animated != 0;
+
+		// a mesh takes at least its 3 counts
+		if (n > (bytes - at) / (3 * sizeof(unsigned int)))
+			return false;
+		meshes.resize(n);
+		for (GEMMappedMesh& mesh : meshes)
+		{
+			unsigned int count = 0;
+			if (!read(at, &count, sizeof(unsigned int)) || count > (bytes - at) / (2 * sizeof(int)))
+				return false;
+			mesh.properties.resize(count);
+			for (GEMMappedProperty& p : mesh.properties)
+			{
+				if (!read_string(at, p.name) || !read_string(at, p.value))
+					return false;
+			}
+			if (!read(at, &count, sizeof(unsigned int)))
+				return false;
+			bool ok = animated ? read_span(at, count, mesh.vertices_animated) : read_span(at, count, mesh.vertices_static);
+			if (!ok || !read(at, &count, sizeof(unsigned int)) || !read_span(at, count, mesh.indices))
+				return false;
+		}
+
+		// static models can end after the meshes
+		if (at == bytes)
+			return true;
+
+		unsigned int bone_count = 0;
+		if (!read(at, &bone_count, sizeof(unsigned int)) || bone_count > (bytes - at) / (sizeof(int) * 2 + sizeof(GEMLoader::GEMMatrix)))
+			return false;
+		bones.resize(bone_count);
+		for (GEMMappedBone& bone : bones)
+		{
+			GEMSpan<GEMLoader::GEMMatrix> offset;
+			if (!read_string(at, bone.name) || !read_span(at, 1, offset) || !read(at, &bone.parent_index, sizeof(int)))
+				return false;
+			bone.offset = offset.data;
+		}
+		if (!read(at, &global_inverse, sizeof(GEMLoader::GEMMatrix)))
+			return false;
+
+		if (!read(at, &n, sizeof(unsigned int)) || n > (bytes - at) / (sizeof(int) * 2 + sizeof(float)))
+			return false;
+		clips.resize(n);
+		for (GEMMappedClip& clip : clips)
+		{
+			int frames = 0;
+			if (!read_string(at, clip.name) || !read(at, &frames, sizeof(int)) || !read(at, &clip.ticks_per_second, sizeof(float)) || frames < 0)
+				return false;
+			size_t frame_bytes = GEMMappedClip::frame_bytes(bone_count);
+			if (frame_bytes > 0 && (size_t)frames > (bytes - at) / frame_bytes)
+				return false;
+			clip.frames = (unsigned int)frames;
+			clip.bones = bone_count;
+			clip.keyframes = base + at;
+			at += (size_t)frames * frame_bytes;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,418 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#define GEM_SCENE_FROM_CHARS
+#endif
+#include "GEMLoader.h"
+#include "gem_mapped.h"
+
+//Scene JSON parser
+/*
+– fills the same GEMLoader::GEMScene as GEMScene::load, in one pass over the mapped file, no GEMJson tree in between
+– the parser walks the bytes itself:
+	• "world" goes straight into the GEMInstance's matrix, numbers are read with std::from_chars (strtof before C++17)
+	• keys are compared in a reused buffer, only material properties and filenames become strings
+	• instances are built in place at the back of scene.instances, nothing is copied after
+– same order as GEMScene::load: properties sorted by name, top level arrays by key (a repeated key is kept twice, the std::map kept the last)
+– every read is checked against the end of the file, bad JSON stops the parse and says at which byte
+– escapes in strings are decoded (\" \\ \n \uXXXX ...), GEMJsonParser keeps them as they are
+*/
+
+class GEMSceneParser
+{
+public:
+	// why and where the last parse stopped, nullptr after a good one
+	const char* error = nullptr;
+	size_t error_at = 0;
+
+	//appends to scene like GEMScene::load, false on a file that does not open or bad JSON
+	bool load(const std::string& filename, GEMLoader::GEMScene& scene)
+	{
+		GEMFileMapping file;
+		if (!file.open(filename))
+		{
+			std::cerr << "Failed to map scene file: " << filename << std::endl;
+			return false;
+		}
+		if (!parse(file.data(), file.size(), scene))
+		{
+			std::cerr << filename << ": " << error << " at byte " << error_at << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool parse(const char* text, size_t size, GEMLoader::GEMScene& scene)
+	{
+		begin = text;
+		p = text;
+		end = text + size;
+		error = nullptr;
+		error_at = 0;
+		size_t first_property = scene.sceneProperties.size();
+		std::vector<InstanceArray> arrays;
+
+		skip_whitespace();
+		if (!expect('{'))
+			return fail("expected {");
+		skip_whitespace();
+		if (!expect('}'))
+		{
+			while (true)
+			{
+				skip_whitespace();
+				std::string name;
+				if (!read_string(name))
+					return false;
+				skip_whitespace();
+				if (!expect(':'))
+					return fail("expected :");
+				skip_whitespace();
+				if (p < end && *p == '[')
+				{
+					arrays.push_back({ name, scene.instances.size(), 0 });
+					if (!parse_instances(scene))
+						return false;
+					arrays.back().count = scene.instances.size() - arrays.back().first;
+				}
+				else
+				{
+					scene.sceneProperties.emplace_back(name);
+					if (!read_value(scene.sceneProperties.back().value))
+						return false;
+				}
+				if (!next(','))
+					break;
+			}
+			if (!expect('}'))
+				return fail("expected , or }");
+		}
+
+		std::sort(scene.sceneProperties.begin() + first_property, scene.sceneProperties.end(), by_name);
+		sort_arrays(arrays, scene.instances);
+		return true;
+	}
+
+private:
+	struct InstanceArray
+	{
+		std::string key;
+		size_t first;
+		size_t count;
+	};
+
+	const char* begin = nullptr;
+	const char* p = nullptr;
+	const char* end = nullptr;
+	// key of the current instance entry, the capacity stays between keys
+	std::string key;
+
+	static bool by_name(const GEMLoader::GEMProperty& a, const GEMLoader::GEMProperty& b)
+	{
+		return a.name < b.name;
+	}
+
+	bool fail(const char* why)
+	{
+		if (!error)
+		{
+			error = why;
+			error_at = p - begin;
+		}
+		return false;
+	}
+
+	void skip_whitespace()
+	{
+		while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+			p++;
+	}
+
+	bool expect(char c)
+	{
+		if (p < end && *p == c)
+		{
+			p++;
+			return true;
+		}
+		return false;
+	}
+
+	//skips whitespace on both sides of c
+	bool next(char c)
+	{
+		skip_whitespace();
+		bool found = expect(c);
+		skip_whitespace();
+		return found;
+	}
+
+	//[ {instance}, ... ], each dictionary becomes one GEMInstance at the back of scene.instances
+	bool parse_instances(GEMLoader::GEMScene& scene)
+	{
+		p++;
+		skip_whitespace();
+		if (expect(']'))
+			return true;
+		while (true)
+		{
+			scene.instances.emplace_back();
+			if (!parse_instance(scene.instances.back()))
+				return false;
+			if (!next(','))
+				break;
+		}
+		return expect(']') || fail("expected , or ]");
+	}
+
+	bool parse_instance(GEMLoader::GEMInstance& instance)
+	{
+		// anything else in the array is an empty instance, as in GEMScene::parseInstance
+		if (!expect('{'))
+			return skip_value();
+		skip_whitespace();
+		if (expect('}'))
+			return true;
+		while (true)
+		{
+			if (!read_string(key))
+				return false;
+			if (!next(':'))
+				return fail("expected :");
+			if (key == "world")
+			{
+				if (!read_matrix(instance.w.m))
+					return false;
+			}
+			else if (key == "filename")
+			{
+				if (!read_value(instance.meshFilename))
+					return false;
+			}
+			else
+			{
+				instance.material.properties.emplace_back(key);
+				if (!read_value(instance.material.properties.back().value))
+					return false;
+			}
+			if (!next(','))
+				break;
+		}
+		if (!expect('}'))
+			return fail("expected , or }");
+		if (instance.material.properties.size() > 1)
+			std::sort(instance.material.properties.begin(), instance.material.properties.end(), by_name);
+		return true;
+	}
+
+	//at least 16 numbers, the rest are skipped
+	bool read_matrix(float* m)
+	{
+		if (!expect('['))
+			return fail("expected [ for world");
+		unsigned int count = 0;
+		skip_whitespace();
+		if (!expect(']'))
+		{
+			while (true)
+			{
+				float v;
+				if (!read_number(v))
+					return false;
+				if (count < 16)
+					m[count] = v;
+				count++;
+				if (!next(','))
+					break;
+			}
+			if (!expect(']'))
+				return fail("expected , or ]");
+		}
+		return count >= 16 || fail("world has less than 16 numbers");
+	}
+
+	bool read_number(float& v)
+	{
+#ifdef GEM_SCENE_FROM_CHARS
+		std::from_chars_result result = std::from_chars(p, end, v);
+		if (result.ec != std::errc())
+			return fail("bad number");
+		p = result.ptr;
+		return true;
+#else
+		// strtof wants a terminated string, a JSON number is only these characters
+		char buffer[64];
+		unsigned int length = 0;
+		while (p + length < end && length < sizeof(buffer) - 1 && strchr("+-.0123456789eE", p[length]) && p[length] != 0)
+		{
+			buffer[length] = p[length];
+			length++;
+		}
+		buffer[length] = 0;
+		char* stop;
+		v = strtof(buffer, &stop);
+		if (stop == buffer)
+			return fail("bad number");
+		p += stop - buffer;
+		return true;
+#endif
+	}
+
+	//"..." into out, escapes decoded
+	bool read_string(std::string& out)
+	{
+		if (!expect('"'))
+			return fail("expected \"");
+		const char* start = p;
+		while (p < end && *p != '"' && *p != '\\')
+			p++;
+		out.assign(start, p - start);
+		while (p < end && *p != '"')
+		{
+			if (*p != '\\')
+			{
+				out.push_back(*p++);
+				continue;
+			}
+			if (++p == end)
+				break;
+			char c = *p++;
+			switch (c)
+			{
+			case 'b': out.push_back('\b'); break;
+			case 'f': out.push_back('\f'); break;
+			case 'n': out.push_back('\n'); break;
+			case 'r': out.push_back('\r'); break;
+			case 't': out.push_back('\t'); break;
+			case 'u':
+			{
+				if (end - p < 4)
+					return fail("bad \\u escape");
+				unsigned int code = (unsigned int)strtoul(std::string(p, 4).c_str(), nullptr, 16);
+				p += 4;
+				// UTF-8, surrogate pairs are not joined
+				if (code < 0x80)
+					out.push_back((char)code);
+				else if (code < 0x800)
+				{
+					out.push_back((char)(0xC0 | (code >> 6)));
+					out.push_back((char)(0x80 | (code & 0x3F)));
+				}
+				else
+				{
+					out.push_back((char)(0xE0 | (code >> 12)));
+					out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+					out.push_back((char)(0x80 | (code & 0x3F)));
+				}
+				break;
+			}
+			default: out.push_back(c); break;
+			}
+		}
+		if (!expect('"'))
+			return fail("unterminated string");
+		return true;
+	}
+
+	//any value as GEMJson::asStr gives it, arrays and dictionaries are skipped and give ""
+	bool read_value(std::string& out)
+	{
+		if (p == end)
+			return fail("expected a value");
+		char c = *p;
+		if (c == '"')
+			return read_string(out);
+		if (c == '-' || (c >= '0' && c <= '9'))
+		{
+			float v;
+			if (!read_number(v))
+				return false;
+			out = std::to_string(v);
+			return true;
+		}
+		out.clear();
+		if (literal("true"))
+		{
+			out = "1";
+			return true;
+		}
+		if (literal("false"))
+		{
+			out = "0";
+			return true;
+		}
+		return skip_value();
+	}
+
+	bool literal(const char* word)
+	{
+		size_t length = strlen(word);
+		if ((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+			return false;
+		p += length;
+		return true;
+	}
+
+	bool skip_value()
+	{
+		if (p == end)
+			return fail("expected a value");
+		if (literal("null") || literal("true") || literal("false"))
+			return true;
+		if (*p == '"')
+		{
+			std::string skipped;
+			return read_string(skipped);
+		}
+		if (*p == '-' || (*p >= '0' && *p <= '9'))
+		{
+			float v;
+			return read_number(v);
+		}
+		char close = *p == '[' ? ']' : *p == '{' ? '}' : 0;
+		if (!close)
+			return fail("expected a value");
+		p++;
+		skip_whitespace();
+		if (expect(close))
+			return true;
+		while (true)
+		{
+			if (close == '}')
+			{
+				std::string skipped;
+				if (!read_string(skipped) || !next(':'))
+					return fail("expected :");
+			}
+			if (!skip_value())
+				return false;
+			if (!next(','))
+				break;
+		}
+		return expect(close) || fail("expected , or a closing bracket");
+	}
+
+	//instances of several top level arrays come in key order, as from the std::map in GEMJson
+	static void sort_arrays(std::vector<InstanceArray>& arrays, std::vector<GEMLoader::GEMInstance>& instances)
+	{
+		if (arrays.size() < 2)
+			return;
+		std::vector<InstanceArray> sorted = arrays;
+		std::stable_sort(sorted.begin(), sorted.end(), [](const InstanceArray& a, const InstanceArray& b) { return a.key < b.key; });
+		size_t first = arrays.front().first;
+		std::vector<GEMLoader::GEMInstance> ordered;
+		ordered.reserve(instances.size() - first);
+		for (const InstanceArray& a : sorted)
+		{
+			for (size_t i = a.first; i < a.first + a.count; i++)
+				ordered.push_back(std::move(instances[i]));
+		}
+		std::move(ordered.begin(), ordered.end(), instances.begin() + first);
+	}
+};
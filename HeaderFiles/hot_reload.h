@@ -0,0 +1,242 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "map_item.h"
+#include "scene_builder.h"
+#include "loadfiles.h"
+
+//Hot reload
+/*
+– FileWatcher polls the write time + size of the watched files, no OS notifications, a few dozen files cost nothing
+– a change is only reported once the file stayed the same for one more poll, an editor still saving is not read half written
+– HotReload maps a changed file to what was made from it and only redoes that:
+	• an instance file (Save/<name>_matrix.txt): the item's instance buffer is rewritten, hitboxes only for the instances that moved
+	• the scene file: Scene_Builder::reload(), batches keep their meshes, new / dropped batches are built / freed
+	• a model (.gem): ModelRegistry::reload() cooks + uploads it once, the instanced items + batches using it take the new meshes, their hitboxes follow the new bounds
+– every reload prints what it did and how long it took
+– an Object of the same .gem draws the new meshes too, animated models (Object_Animation) are not reloaded, skeleton + clip changes still need a restart
+*/
+
+// seconds between polls, a change shows up after two
+#define HOT_RELOAD_POLL_SECONDS 0.25f
+
+//write time + size of a file, false when it is missing
+inline bool file_stamp(const std::string& filename, unsigned long long& time, unsigned long long& size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	time = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+	time = (unsigned long long)st.st_mtime;
+	size = (unsigned long long)st.st_size;
+#endif
+	return true;
+}
+
+class FileWatcher
+{
+public:
+	void watch(const std::string& filename)
+	{
+		for (const WatchedFile& file : files)
+		{
+			if (file.name == filename)
+				return;
+		}
+		WatchedFile file;
+		file.name = filename;
+		file_stamp(filename, file.time, file.size);
+		files.push_back(file);
+	}
+
+	//files that changed and then stayed as they are for one poll
+	void poll(std::vector<std::string>& changed)
+	{
+		for (WatchedFile& file : files)
+		{
+			unsigned long long time = 0;
+			unsigned long long size = 0;
+			if (!file_stamp(file.name, time, size))
+				continue;
+			if (time != file.time || size != file.size)
+			{
+				file.time = time;
+				file.size = size;
+				file.pending = true;
+			}
+			else if (file.pending)
+			{
+				file.pending = false;
+				changed.push_back(file.name);
+			}
+		}
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)files.size();
+	}
+
+private:
+	struct WatchedFile
+	{
+		std::string name;
+		unsigned long long time = 0;
+		unsigned long long size = 0;
+		bool pending = false;
+	};
+	std::vector<WatchedFile> files;
+};
+
+class HotReload
+{
+public:
+	void init(Core* _core)
+	{
+		core = _core;
+	}
+
+	//its instance file + its model
+	void watch(Item_Ins_Base* item)
+	{
+		items.push_back(item);
+		if (!item->matrix_file.empty())
+			watcher.watch(item->matrix_file);
+		watcher.watch(model_file(item->name));
+	}
+
+	void watch(Ground_Grid* ground)
+	{
+		grounds.push_back(ground);
+		watcher.watch(ground->matrix_file);
+	}
+
+	//the scene file + the models of its batches
+	void watch(Scene_Builder* scene)
+	{
+		scenes.push_back(scene);
+		watcher.watch(scene->filename);
+		watch_models(scene);
+	}
+
+	//main thread, once per frame, before core.beginFrame(): the uploads reset and execute the command list
+	void update(float dt)
+	{
+		since_poll += dt;
+		if (since_poll < HOT_RELOAD_POLL_SECONDS)
+			return;
+		since_poll = 0;
+		changed.clear();
+		watcher.poll(changed);
+		for (const std::string& filename : changed)
+			reload(filename);
+	}
+
+private:
+	Core* core = nullptr;
+	FileWatcher watcher;
+	float since_poll = 0;
+	std::vector<std::string> changed;
+	std::vector<Item_Ins_Base*> items;
+	std::vector<Ground_Grid*> grounds;
+	std::vector<Scene_Builder*> scenes;
+
+	static std::string model_file(const std::string& name)
+	{
+		return "Models/" + name + ".gem";
+	}
+
+	void watch_models(Scene_Builder* scene)
+	{
+		std::vector<std::string> files;
+		scene->model_files(files);
+		for (const std::string& file : files)
+			watcher.watch(file);
+	}
+
+	void reload(const std::string& filename)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned int reloaded = 0;
+		std::vector<INSTANCE> instances;
+		for (Item_Ins_Base* item : items)
+		{
+			if (item->matrix_file == filename)
+			{
+				instances.clear();
+				if (!load_instance_matrices(filename, instances))
+					continue;
+				unsigned int moved = item->set_instances(core, instances);
+				std::cout << "Hot reload " << filename << ": " << item->name << " " << item->model.instances_matix.size() << " instances, " << moved << " moved";
+				print_time(start);
+				reloaded++;
+			}
+			if (model_file(item->name) == filename)
+				reloaded += reload_model(item, filename, start);
+		}
+		for (Ground_Grid* ground : grounds)
+		{
+			if (ground->matrix_file != filename)
+				continue;
+			instances.clear();
+			if (!load_instance_matrices(filename, instances))
+				continue;
+			ground->grounds.set_instances(core, instances);
+			std::cout << "Hot reload " << filename << ": " << ground->grounds.instances_matix.size() << " ground tiles";
+			print_time(start);
+			reloaded++;
+		}
+		for (Scene_Builder* scene : scenes)
+		{
+			if (scene->filename == filename)
+			{
+				if (!scene->reload(core))
+					continue;
+				// a new batch can bring a model that is not watched yet
+				watch_models(scene);
+				std::cout << "Hot reload " << filename << ": " << scene->instance_count << " instances in " << scene->batches.size() << " batches, "
+					<< scene->moved << " moved, " << scene->built << " batches built, " << scene->dropped << " dropped";
+				print_time(start);
+				reloaded++;
+				continue;
+			}
+			for (Item_Ins_Base* batch : scene->batches)
+			{
+				if (model_file(batch->name) == filename)
+					reloaded += reload_model(batch, filename, start);
+			}
+		}
+		if (reloaded == 0)
+			std::cout << "Hot reload " << filename << ": nothing reloaded" << std::endl;
+	}
+
+	unsigned int reload_model(Item_Ins_Base* item, const std::string& filename, std::chrono::high_resolution_clock::time_point start)
+	{
+		if (!item->reload_model(core))
+		{
+			std::cerr << "Hot reload " << filename << ": does not load, the old meshes stay" << std::endl;
+			return 0;
+		}
+		std::cout << "Hot reload " << filename << ": " << item->model.meshes.size() << " meshes, " << item->world_hitboxs.size() << " hitboxes";
+		print_time(start);
+		return 1;
+	}
+
+	static void print_time(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::cout << ", " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+	}
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <cstring>
+
+//16-bit index buffers
+/*
+– R16_UINT halves the index buffer (and the index fetch bandwidth)
+– possible whenever every index fits, numVertices <= 65535
+– bigger meshes can still use 16-bit indices:
+	• cut the triangle list into chunks of < 64k vertices
+	• each chunk's vertices are stored contiguously in the one vertex buffer
+	• indices are local to the chunk, DrawIndexedInstanced adds BaseVertexLocation
+– only split when it is smaller overall (shared vertices get duplicated at the cuts)
+*/
+
+#define INDEX_16BIT_MAX_VERTICES 65535
+
+//one DrawIndexedInstanced worth of a mesh
+struct IndexChunk
+{
+	unsigned int startIndex;
+	unsigned int indexCount;
+	int baseVertex;
+};
+
+struct IndexBufferData
+{
+	bool is16Bit = false;
+	// only filled when the mesh was split, otherwise the source vertices are uploaded as they are
+	std::vector<unsigned char> splitVertices;
+	unsigned int numVertices = 0;
+	std::vector<unsigned short> indices16;
+	std::vector<IndexChunk> chunks;
+
+	unsigned int indexSizeInBytes() const
+	{
+		return is16Bit ? sizeof(unsigned short) : sizeof(unsigned int);
+	}
+
+	unsigned int numIndices(unsigned int numIndices32) const
+	{
+		return is16Bit ? (unsigned int)indices16.size() : numIndices32;
+	}
+
+	const void* vertexData(const void* sourceVertices) const
+	{
+		return splitVertices.empty() ? sourceVertices : splitVertices.data();
+	}
+
+	const void* indexData(const unsigned int* sourceIndices) const
+	{
+		return is16Bit ? (const void*)indices16.data() : (const void*)sourceIndices;
+	}
+};
+
+class IndexBufferBuilder
+{
+public:
+	static bool fits_16bit(unsigned int numVertices)
+	{
+		return numVertices <= INDEX_16BIT_MAX_VERTICES;
+	}
+
+	static void narrow_to_16bit(const unsigned int* indices, unsigned int numIndices, std::vector<unsigned short>& out)
+	{
+		out.resize(numIndices);
+		for (unsigned int i = 0; i < numIndices; i++)
+		{
+			out[i] = (unsigned short)indices[i];
+		}
+	}
+
+	//greedy split of a triangle list into chunks that each reference at most maxChunkVertices vertices
+	//output vertices are grouped per chunk, output indices are relative to the chunk's baseVertex
+	static void split_16bit(const void* vertices, unsigned int vertexSizeInBytes, unsigned int numVertices,
+		const unsigned int* indices, unsigned int numIndices,
+		std::vector<unsigned char>& outVertices, std::vector<unsigned short>& outIndices, std::vector<IndexChunk>& chunks,
+		unsigned int maxChunkVertices = INDEX_16BIT_MAX_VERTICES)
+	{
+		const unsigned char* src = static_cast<const unsigned char*>(vertices);
+		const unsigned int unused = 0xFFFFFFFF;
+
+		// vertex -> local index in the current chunk, stamped with the chunk id to avoid clearing
+		std::vector<unsigned int> local(numVertices, unused);
+		std::vector<unsigned int> stamp(numVertices, unused);
+
+		outVertices.clear();
+		outIndices.clear();
+		chunks.clear();
+		outIndices.reserve(numIndices);
+
+		IndexChunk chunk = { 0, 0, 0 };
+		unsigned int chunkVertices = 0;
+
+		for (unsigned int t = 0; t + 2 < numIndices; t += 3)
+		{
+			unsigned int chunkId = (unsigned int)chunks.size();
+
+			// how many new vertices would this triangle add
+			unsigned int added = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t + k];
+				bool seen = stamp[v] == chunkId;
+				for (int j = 0; j < k; j++)
+				{
+					if (indices[t + j] == v)
+						seen = true;
+				}
+				if (!seen)
+					added++;
+			}
+
+			// close the chunk
+			if (chunkVertices + added > maxChunkVertices)
+			{
+				chunks.push_back(chunk);
+				chunk.startIndex = (unsigned int)outIndices.size();
+				chunk.indexCount = 0;
+				chunk.baseVertex = (int)(outVertices.size() / vertexSizeInBytes);
+				chunkVertices = 0;
+				chunkId++;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t + k];
+				if (stamp[v] != chunkId)
+				{
+					stamp[v] = chunkId;
+					local[v] = chunkVertices++;
+					outVertices.insert(outVertices.end(), src + (size_t)v * vertexSizeInBytes, src + ((size_t)v + 1) * vertexSizeInBytes);
+				}
+				outIndices.push_back((unsigned short)local[v]);
+				chunk.indexCount++;
+			}
+		}
+		if (chunk.indexCount > 0)
+			chunks.push_back(chunk);
+	}
+
+	//pick the smallest layout: 16-bit, split 16-bit or the 32-bit indices as given
+	static void build(const void* vertices, unsigned int vertexSizeInBytes, unsigned int numVertices,
+		const unsigned int* indices, unsigned int numIndices, IndexBufferData& out)
+	{
+		out.numVertices = numVertices;
+		out.splitVertices.clear();
+		out.chunks.clear();
+
+		if (fits_16bit(numVertices))
+		{
+			out.is16Bit = true;
+			narrow_to_16bit(indices, numIndices, out.indices16);
+			out.chunks.push_back({ 0, numIndices, 0 });
+			return;
+		}
+
+		std::vector<unsigned char> splitVertices;
+		std::vector<unsigned short> splitIndices;
+		std::vector<IndexChunk> splitChunks;
+		split_16bit(vertices, vertexSizeInBytes, numVertices, indices, numIndices, splitVertices, splitIndices, splitChunks);
+
+		size_t size32 = (size_t)numVertices * vertexSizeInBytes + (size_t)numIndices * sizeof(unsigned int);
+		size_t size16 = splitVertices.size() + splitIndices.size() * sizeof(unsigned short);
+		if (size16 < size32)
+		{
+			out.is16Bit = true;
+			out.numVertices = (unsigned int)(splitVertices.size() / vertexSizeInBytes);
+			out.splitVertices.swap(splitVertices);
+			out.indices16.swap(splitIndices);
+			out.chunks.swap(splitChunks);
+			return;
+		}
+
+		out.is16Bit = false;
+		out.indices16.clear();
+		out.chunks.push_back({ 0, numIndices, 0 });
+	}
+};
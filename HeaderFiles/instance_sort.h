@@ -0,0 +1,259 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cfloat>
+#include "vectors.h"
+#include "frustum.h"
+#include "mesh.h"
+
+//Back to front sorting of alpha instances
+/*
+– alpha blended foliage has to be drawn far -> near, the instance files are in random order
+– per frame:
+	1. frustum cull the instance bounding spheres (world space, precomputed once)
+	2. view depth of every visible instance = w of the clip position = row 3 of VP . centre
+	3. quantise the depth to a 16-bit key, far = small key
+	4. sort the keys, carrying the instance ids
+– the camera moves a little per frame so last frame's order is nearly sorted:
+	• visible ids are walked in last frame's order, newly visible ones go on the end
+	• insertion sort first, O(n + moves), with a budget of moves per key
+	• over budget -> LSD radix sort, 8 bits per pass, blocks split over threads for big counts
+	  (the half done insertion sort leaves keys and ids in step, the radix sort just carries on)
+– every buffer is a member and only grows, nothing is allocated once the sizes settle
+*/
+
+#define INSTANCE_SORT_KEY_BITS 16
+#define INSTANCE_SORT_RADIX_BITS 8
+// insertion sort budget, about what the two radix passes cost per key
+#define INSTANCE_SORT_MOVES_PER_KEY 4
+// below this many instances the radix passes run on one thread
+#define INSTANCE_SORT_PARALLEL_MIN 8192
+#define INSTANCE_SORT_MAX_THREADS 8
+
+struct InstanceSortStats
+{
+	unsigned int visible = 0;
+	unsigned int culled = 0;
+	unsigned int out_of_order = 0;
+	bool used_radix = false;
+};
+
+class InstanceDepthSorter
+{
+public:
+	// world space bounding sphere per instance, w = radius
+	std::vector<Vec4> bounds;
+	// visible instances, far to near, ready to upload
+	std::vector<INSTANCE> sorted;
+	InstanceSortStats stats;
+
+	//precompute the world spheres, the instances are static
+	void init_bounds(const std::vector<INSTANCE>& instances, const Vec3& local_center, float local_radius)
+	{
+		bounds.resize(instances.size());
+		for (unsigned int i = 0; i < instances.size(); i++)
+		{
+			const Matrix& w = instances[i].w;
+			float scale = sqrtf(max(max(SQ(w.m[0]) + SQ(w.m[4]) + SQ(w.m[8]),
+				SQ(w.m[1]) + SQ(w.m[5]) + SQ(w.m[9])),
+				SQ(w.m[2]) + SQ(w.m[6]) + SQ(w.m[10])));
+			Vec3 c = w.mulPoint(local_center);
+			bounds[i] = Vec4(c.x, c.y, c.z, local_radius * scale);
+		}
+		order.clear();
+		listed.assign(instances.size(), 0);
+		frame = 0;
+	}
+
+	//cull + sort, the result is in sorted
+	void sort(const std::vector<INSTANCE>& instances, const Matrix& vp)
+	{
+		stats = InstanceSortStats();
+		Frustum frustum;
+		frustum.extract(vp);
+		const float* row3 = vp.a[3];
+
+		frame++;
+		if (listed.size() != instances.size())
+			init_listed(instances.size());
+
+		// keep last frame's order for everything still visible
+		unsigned int n = 0;
+		next.resize(instances.size());
+		for (unsigned int id : order)
+		{
+			const Vec4& b = bounds[id];
+			if (frustum.sphere_visible(Vec3(b.x, b.y, b.z), b.w))
+			{
+				next[n++] = id;
+				listed[id] = frame;
+			}
+		}
+		for (unsigned int id = 0; id < instances.size(); id++)
+		{
+			if (listed[id] == frame)
+				continue;
+			const Vec4& b = bounds[id];
+			if (frustum.sphere_visible(Vec3(b.x, b.y, b.z), b.w))
+			{
+				next[n++] = id;
+				listed[id] = frame;
+			}
+		}
+		next.resize(n);
+		order.swap(next);
+		stats.visible = n;
+		stats.culled = (unsigned int)instances.size() - n;
+
+		// view depth -> key, far first
+		depths.resize(n);
+		float depth_min = FLT_MAX;
+		float depth_max = -FLT_MAX;
+		for (unsigned int i = 0; i < n; i++)
+		{
+			const Vec4& b = bounds[order[i]];
+			depths[i] = row3[0] * b.x + row3[1] * b.y + row3[2] * b.z + row3[3];
+			depth_min = min(depth_min, depths[i]);
+			depth_max = max(depth_max, depths[i]);
+		}
+		const float key_max = (float)((1 << INSTANCE_SORT_KEY_BITS) - 1);
+		float scale = depth_max > depth_min ? key_max / (depth_max - depth_min) : 0.0f;
+		keys.resize(n);
+		unsigned int out_of_order = 0;
+		for (unsigned int i = 0; i < n; i++)
+		{
+			keys[i] = (unsigned int)((depth_max - depths[i]) * scale);
+			if (i > 0 && keys[i] < keys[i - 1])
+				out_of_order++;
+		}
+		stats.out_of_order = out_of_order;
+
+		if (out_of_order > 0 && !insertion_sort(n * INSTANCE_SORT_MOVES_PER_KEY))
+		{
+			radix_sort();
+			stats.used_radix = true;
+		}
+
+		sorted.resize(n);
+		for (unsigned int i = 0; i < n; i++)
+		{
+			sorted[i] = instances[order[i]];
+		}
+	}
+
+private:
+	// instance ids in sort order, last frame's result between calls
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> next;
+	std::vector<unsigned int> keys;
+	std::vector<unsigned int> keys_tmp;
+	std::vector<float> depths;
+	// frame stamp, listed[id] == frame once id is in this frame's list
+	std::vector<unsigned int> listed;
+	unsigned int frame = 0;
+	std::vector<unsigned int> histograms;
+
+	void init_listed(size_t count)
+	{
+		listed.assign(count, 0);
+		order.clear();
+		frame = 1;
+	}
+
+	//false when it ran out of moves, keys and order are still a valid pair then
+	bool insertion_sort(unsigned int max_moves)
+	{
+		unsigned int moves = 0;
+		for (unsigned int i = 1; i < keys.size(); i++)
+		{
+			unsigned int key = keys[i];
+			unsigned int id = order[i];
+			unsigned int j = i;
+			while (j > 0 && keys[j - 1] > key)
+			{
+				keys[j] = keys[j - 1];
+				order[j] = order[j - 1];
+				j--;
+			}
+			keys[j] = key;
+			order[j] = id;
+			moves += i - j;
+			if (moves > max_moves)
+				return false;
+		}
+		return true;
+	}
+
+	//stable LSD radix sort of keys, order follows
+	void radix_sort()
+	{
+		const unsigned int buckets = 1 << INSTANCE_SORT_RADIX_BITS;
+		const unsigned int n = (unsigned int)keys.size();
+		unsigned int threads = 1;
+		if (n >= INSTANCE_SORT_PARALLEL_MIN)
+			threads = max(1u, min((unsigned int)INSTANCE_SORT_MAX_THREADS, std::thread::hardware_concurrency()));
+		unsigned int block = (n + threads - 1) / threads;
+
+		keys_tmp.resize(n);
+		next.resize(n);
+		histograms.resize(threads * buckets);
+
+		for (unsigned int shift = 0; shift < INSTANCE_SORT_KEY_BITS; shift += INSTANCE_SORT_RADIX_BITS)
+		{
+			std::fill(histograms.begin(), histograms.end(), 0);
+
+			run_blocks(threads, [&](unsigned int t)
+			{
+				unsigned int* histogram = &histograms[t * buckets];
+				unsigned int end = min(n, (t + 1) * block);
+				for (unsigned int i = t * block; i < end; i++)
+					histogram[(keys[i] >> shift) & (buckets - 1)]++;
+			});
+
+			// bucket by bucket, block by block keeps it stable
+			unsigned int offset = 0;
+			for (unsigned int d = 0; d < buckets; d++)
+			{
+				for (unsigned int t = 0; t < threads; t++)
+				{
+					unsigned int count = histograms[t * buckets + d];
+					histograms[t * buckets + d] = offset;
+					offset += count;
+				}
+			}
+
+			run_blocks(threads, [&](unsigned int t)
+			{
+				unsigned int* histogram = &histograms[t * buckets];
+				unsigned int end = min(n, (t + 1) * block);
+				for (unsigned int i = t * block; i < end; i++)
+				{
+					unsigned int dst = histogram[(keys[i] >> shift) & (buckets - 1)]++;
+					keys_tmp[dst] = keys[i];
+					next[dst] = order[i];
+				}
+			});
+
+			keys.swap(keys_tmp);
+			order.swap(next);
+		}
+	}
+
+	template<typename FUNC>
+	static void run_blocks(unsigned int threads, FUNC func)
+	{
+		if (threads == 1)
+		{
+			func(0);
+			return;
+		}
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (unsigned int t = 1; t < threads; t++)
+			workers.emplace_back(func, t);
+		func(0);
+		for (std::thread& w : workers)
+			w.join();
+	}
+};
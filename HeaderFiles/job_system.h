@@ -0,0 +1,173 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+//Job system
+/*
+– a fixed pool of worker threads started once, jobs are std::function<void()>
+– submit() queues a job, wait() blocks until every submitted job is done
+– a job submitted with a JobGroup is also counted there, wait(group) joins only those:
+	• the pool is shared (AssetLoader, AnimationJobs), a frame's join does not wait on a load still running
+	• the waiting thread runs the group's queued jobs too, so a pool of N workers uses N + 1 cores
+	• a job can wait on a group of its own (parallel_for inside a job), it is not counted there
+– parallel_for() splits [0, count) into chunks of grain items, one job per chunk, in a group of its own
+*/
+
+//jobs counted together, JobSystem::wait(group) joins them
+struct JobGroup
+{
+	// queued + running
+	unsigned int pending = 0;
+};
+
+class JobSystem
+{
+public:
+	~JobSystem()
+	{
+		shutdown();
+	}
+
+	//threads = 0 -> one worker per core besides the calling thread
+	void init(unsigned int threads = 0)
+	{
+		shutdown();
+		if (threads == 0)
+		{
+			unsigned int cores = std::thread::hardware_concurrency();
+			threads = cores > 1 ? cores - 1 : 0;
+		}
+		stopping = false;
+		for (unsigned int i = 0; i < threads; i++)
+			workers.emplace_back([this]() { worker_loop(); });
+	}
+
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& w : workers)
+			w.join();
+		workers.clear();
+	}
+
+	unsigned int worker_count() const
+	{
+		return (unsigned int)workers.size();
+	}
+
+	void submit(std::function<void()> job, JobGroup* group = nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ std::move(job), group });
+			pending++;
+			if (group)
+				group->pending++;
+		}
+		wake.notify_one();
+	}
+
+	//every job of every group, help out until the queue is empty, then wait for the jobs still running
+	//not from inside a job, that one counts as pending
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (pending > 0)
+		{
+			if (!jobs.empty())
+			{
+				run_one(jobs.begin(), lock);
+				continue;
+			}
+			done.wait(lock);
+		}
+	}
+
+	//only the group's jobs: help with the ones still queued, then wait for the ones running, other jobs are left to the workers
+	void wait(JobGroup& group)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (group.pending > 0)
+		{
+			auto job = std::find_if(jobs.begin(), jobs.end(), [&group](const QueuedJob& j) { return j.group == &group; });
+			if (job != jobs.end())
+			{
+				run_one(job, lock);
+				continue;
+			}
+			done.wait(lock);
+		}
+	}
+
+	//func(begin, end) over [0, count), returns once every chunk has run
+	template<typename FUNC>
+	void parallel_for(unsigned int count, unsigned int grain, FUNC func)
+	{
+		if (count == 0)
+			return;
+		grain = grain > 0 ? grain : 1;
+		// no workers or a single chunk, skip the queue
+		if (workers.empty() || count <= grain)
+		{
+			func(0u, count);
+			return;
+		}
+		JobGroup group;
+		for (unsigned int begin = 0; begin < count; begin += grain)
+		{
+			unsigned int end = begin + grain < count ? begin + grain : count;
+			submit([func, begin, end]() { func(begin, end); }, &group);
+		}
+		wait(group);
+	}
+
+private:
+	struct QueuedJob
+	{
+		std::function<void()> func;
+		JobGroup* group;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<QueuedJob> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned int pending = 0;
+	bool stopping = false;
+
+	//takes job out of the queue and runs it, lock is held on entry and on return
+	void run_one(std::deque<QueuedJob>::iterator job, std::unique_lock<std::mutex>& lock)
+	{
+		std::function<void()> func = std::move(job->func);
+		JobGroup* group = job->group;
+		jobs.erase(job);
+		lock.unlock();
+		func();
+		lock.lock();
+		bool group_done = group && --group->pending == 0;
+		if (--pending == 0 || group_done)
+			done.notify_all();
+	}
+
+	void worker_loop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			run_one(jobs.begin(), lock);
+		}
+	}
+};
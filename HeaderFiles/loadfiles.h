@@ -4,6 +4,17 @@
 #include <vector>
 #include "vectors.h"
 #include "mesh.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "animation.h"
+#include "animation_jobs.h"
+#include "skinning.h"
+#include "root_motion.h"
+#include "gem_mapped.h"
+#include "gem_cooked.h"
+#include "gem_scene.h"
+#include "material_table.h"
+#include <chrono>
 #include <random>
 
 #define FILE_NAME_FLOWER_MATRIX "Save/flower_matrix.txt"
@@ -13,6 +24,7 @@
 #define FILE_NAME_GRASS_SET_MATRIX "Save/grass_set_matrix.txt"
 #define FILE_NAME_MAP_BOUNDRAY_MATRIX "Save/map_boundray_matrix.txt"
 #define FILE_NAME_METAL_FENCE_MATRIX "Save/metal_fence_matrix.txt"
+#define FILE_NAME_LEVEL_SCENE "Save/level.json"
 
 
 inline float random_float(float min_v, float max_v)
@@ -254,3 +266,1001 @@ void create_matrix_files()
     //std::vector<INSTANCE> fence3_instanse = generateFenceRectangle(Vec3(0, 0, 0), 4000.0f, 4000.0f, 250.0f, Vec3(100, 100, 100), Matrix().mul(Matrix::rotateY(M_PI / 2)));
     //save_instance_matrices(FILE_NAME_METAL_FENCE_MATRIX, fence3_instanse);
 }
+
+
+//JSON string with " and \\ escaped
+std::string scene_json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+//a GEMScene as JSON that GEMScene::load and GEMSceneParser read back, property values are written as strings
+void save_scene(const std::string filename, const GEMLoader::GEMScene& scene)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open scene file: " << filename << std::endl;
+        return;
+    }
+    file << "{\n";
+    for (const GEMLoader::GEMProperty& property : scene.sceneProperties)
+        file << "  " << scene_json_string(property.name) << ": " << scene_json_string(property.value) << ",\n";
+    file << "  \"instances\": [\n";
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        const GEMLoader::GEMInstance& instance = scene.instances[i];
+        file << "    {\"filename\": " << scene_json_string(instance.meshFilename) << ", \"world\": [";
+        for (int k = 0; k < 16; k++)
+            file << (k ? ", " : "") << instance.w.m[k];
+        file << "]";
+        for (const GEMLoader::GEMProperty& property : instance.material.properties)
+            file << ", " << scene_json_string(property.name) << ": " << scene_json_string(property.value);
+        file << "}" << (i + 1 < scene.instances.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+}
+
+//the hand placed items of the instance files as one scene, material flags as Scene_Builder reads them
+void create_scene_file(const std::string filename = FILE_NAME_LEVEL_SCENE)
+{
+    struct Item
+    {
+        const char* model;
+        const char* matrix_file;
+        bool vertex_animation;
+        bool hitbox;
+        bool depth_sort;
+    };
+    const Item items[] = {
+        { "Fence_Wooden_Old_Full_26h", FILE_NAME_FENCE_MATRIX, false, true, false },
+        { "pine2", FILE_NAME_MAP_BOUNDRAY_MATRIX, false, true, false },
+        { "Fence_Metal_Full_14g", FILE_NAME_METAL_FENCE_MATRIX, false, true, false },
+        { "flower4", FILE_NAME_FLOWER_MATRIX, true, false, true },
+        { "Grass_Sets_Full_01e", FILE_NAME_GRASS_SET_MATRIX, true, false, true },
+        { "Dead_Plants_01d", FILE_NAME_GRASS_DEAD_MATRIX, true, false, true },
+    };
+    GEMLoader::GEMScene scene;
+    GEMLoader::GEMProperty name("name");
+    name.value = "level";
+    scene.sceneProperties.push_back(name);
+    for (const Item& item : items)
+    {
+        std::vector<INSTANCE> matrices;
+        load_instance_matrices(item.matrix_file, matrices);
+        for (const INSTANCE& matrix : matrices)
+        {
+            GEMLoader::GEMInstance instance;
+            instance.meshFilename = std::string("Models/") + item.model + ".gem";
+            memcpy(instance.w.m, matrix.w.m, sizeof(instance.w.m));
+            const char* flags[] = { "depth_sort", "hitbox", "vertex_animation" };
+            const bool values[] = { item.depth_sort, item.hitbox, item.vertex_animation };
+            for (int k = 0; k < 3; k++)
+            {
+                GEMLoader::GEMProperty property(flags[k]);
+                property.value = values[k] ? "1" : "0";
+                instance.material.properties.push_back(property);
+            }
+            scene.instances.push_back(instance);
+        }
+    }
+    save_scene(filename, scene);
+}
+
+
+//run the mesh optimisation stage over every .gem in the folder and print ACMR after each step
+void report_mesh_optimization(const std::string folder = "Models/")
+{
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA((folder + "*.gem").c_str(), &find_data);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "No .gem files in: " << folder << std::endl;
+        return;
+    }
+
+    do
+    {
+        std::string filename = find_data.cFileName;
+        GEMLoader::GEMModelLoader loader;
+        std::vector<GEMLoader::GEMMesh> gemmeshes;
+        GEMLoader::GEMAnimation gemanimation;
+        loader.load(folder + filename, gemmeshes, gemanimation);
+
+        for (unsigned int i = 0; i < gemmeshes.size(); i++)
+        {
+            std::string name = filename + "[" + std::to_string(i) + "]";
+            if (gemmeshes[i].isAnimated())
+            {
+                std::vector<ANIMATED_VERTEX> vertices(gemmeshes[i].verticesAnimated.size());
+                memcpy(vertices.data(), gemmeshes[i].verticesAnimated.data(), vertices.size() * sizeof(ANIMATED_VERTEX));
+                MeshOptimizer::optimize(vertices, gemmeshes[i].indices).print(name);
+            }
+            else
+            {
+                std::vector<STATIC_VERTEX> vertices(gemmeshes[i].verticesStatic.size());
+                memcpy(vertices.data(), gemmeshes[i].verticesStatic.data(), vertices.size() * sizeof(STATIC_VERTEX));
+                MeshOptimizer::optimize(vertices, gemmeshes[i].indices).print(name);
+            }
+        }
+    } while (FindNextFileA(find, &find_data));
+
+    FindClose(find);
+}
+
+
+//build meshlets for one model and cull them from a ring of cameras around it
+void report_meshlets(const std::string model_name, const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+
+    std::vector<MeshletData> meshlets(gemmeshes.size());
+    Vec3 box_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 box_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < gemmeshes.size(); i++)
+    {
+        // only the positions are needed, animated meshes use their bind pose
+        std::vector<STATIC_VERTEX> vertices;
+        if (gemmeshes[i].isAnimated())
+        {
+            vertices.resize(gemmeshes[i].verticesAnimated.size());
+            for (unsigned int j = 0; j < vertices.size(); j++)
+                memcpy(&vertices[j], &gemmeshes[i].verticesAnimated[j], sizeof(STATIC_VERTEX));
+        }
+        else
+        {
+            vertices.resize(gemmeshes[i].verticesStatic.size());
+            memcpy(vertices.data(), gemmeshes[i].verticesStatic.data(), vertices.size() * sizeof(STATIC_VERTEX));
+        }
+        for (const STATIC_VERTEX& v : vertices)
+        {
+            box_min = Min(box_min, v.pos);
+            box_max = Max(box_max, v.pos);
+        }
+
+        MeshOptimizer::optimize(vertices, gemmeshes[i].indices);
+        MeshletBuilder::build(vertices, gemmeshes[i].indices, meshlets[i]);
+
+        unsigned int vertex_count = (unsigned int)meshlets[i].vertices.size();
+        unsigned int triangle_count = (unsigned int)meshlets[i].triangles.size() / 3;
+        unsigned int count = (unsigned int)meshlets[i].meshlets.size();
+        std::cout << model_name << "[" << i << "] meshlets: " << count
+            << " avg verts: " << (count ? (float)vertex_count / count : 0)
+            << " avg tris: " << (count ? (float)triangle_count / count : 0) << std::endl;
+    }
+
+    // 8 cameras on a ring, looking at the centre from 2x the model size
+    Vec3 center = (box_min + box_max) * 0.5f;
+    float distance = (box_max - box_min).length();
+    Matrix projection = Matrix::perspective(60.0f, 16.0f / 9.0f, 0.01f, 30000.0f);
+    Matrix world;
+    for (int c = 0; c < 8; c++)
+    {
+        float angle = c * (float)M_PI / 4.0f;
+        Vec3 camera_pos = center + Vec3(cosf(angle), 0.3f, sinf(angle)) * distance;
+        Frustum frustum;
+        frustum.extract(projection.mul(Matrix::lookAt(camera_pos, center, Vec3(0, 1, 0))));
+
+        MeshletCullStats stats;
+        std::vector<unsigned int> visible;
+        for (const MeshletData& data : meshlets)
+            MeshletCuller::cull(data, world, frustum, camera_pos, true, visible, &stats);
+        std::cout << "  camera " << c << " total: " << stats.total << " frustum culled: " << stats.frustum_culled
+            << " cone culled: " << stats.cone_culled << " visible: " << stats.visible << std::endl;
+    }
+}
+
+
+//skeleton + clips of a .gem into an Animation, clips are packed unless asked not to
+void load_gem_animation(const GEMLoader::GEMAnimation& gemanimation, Animation& animation, bool pack = true)
+{
+    memcpy(&animation.skeleton.globalInverse, &gemanimation.globalInverse, 16 * sizeof(float));
+    for (int i = 0; i < gemanimation.bones.size(); i++)
+    {
+        Bone bone;
+        bone.name = gemanimation.bones[i].name;
+        memcpy(&bone.offset, &gemanimation.bones[i].offset, 16 * sizeof(float));
+        bone.parentIndex = gemanimation.bones[i].parentIndex;
+        animation.skeleton.bones.push_back(bone);
+    }
+    animation.skeleton.buildIndex();
+
+    for (int i = 0; i < gemanimation.animations.size(); i++)
+    {
+        std::string name = gemanimation.animations[i].name;
+        AnimationSequence aseq;
+        aseq.ticksPerSecond = gemanimation.animations[i].ticksPerSecond;
+        for (int n = 0; n < gemanimation.animations[i].frames.size(); n++)
+        {
+            AnimationFrame frame;
+            for (int index = 0; index < gemanimation.animations[i].frames[n].positions.size(); index++)
+            {
+                Vec3 p;
+                Quaternion q;
+                Vec3 s;
+                memcpy(&p, &gemanimation.animations[i].frames[n].positions[index], sizeof(Vec3));
+                frame.positions.push_back(p);
+                memcpy(&q, &gemanimation.animations[i].frames[n].rotations[index], sizeof(Quaternion));
+                frame.rotations.push_back(q);
+                memcpy(&s, &gemanimation.animations[i].frames[n].scales[index], sizeof(Vec3));
+                frame.scales.push_back(s);
+            }
+            aseq.frames.push_back(frame);
+        }
+        if (pack)
+            aseq.pack();
+        animation.addAnimation(name, aseq);
+    }
+}
+
+
+//same as above straight from a mapped .gem, the keyframes are copied once into the AnimationFrames
+void load_gem_animation(const GEMMappedModel& gem, Animation& animation, bool pack = true)
+{
+    memcpy(&animation.skeleton.globalInverse, &gem.global_inverse, 16 * sizeof(float));
+    for (const GEMMappedBone& gembone : gem.bones)
+    {
+        Bone bone;
+        bone.name = gembone.name.str();
+        memcpy(&bone.offset, gembone.offset, 16 * sizeof(float));
+        bone.parentIndex = gembone.parent_index;
+        animation.skeleton.bones.push_back(bone);
+    }
+    animation.skeleton.buildIndex();
+
+    for (const GEMMappedClip& clip : gem.clips)
+    {
+        AnimationSequence aseq;
+        aseq.ticksPerSecond = clip.ticks_per_second;
+        aseq.frames.resize(clip.frames);
+        for (unsigned int n = 0; n < clip.frames; n++)
+        {
+            AnimationFrame& frame = aseq.frames[n];
+            frame.positions.resize(clip.bones);
+            frame.rotations.resize(clip.bones);
+            frame.scales.resize(clip.bones);
+            memcpy(frame.positions.data(), clip.positions(n).data, clip.bones * sizeof(Vec3));
+            memcpy(frame.rotations.data(), clip.rotations(n).data, clip.bones * sizeof(Quaternion));
+            memcpy(frame.scales.data(), clip.scales(n).data, clip.bones * sizeof(Vec3));
+        }
+        if (pack)
+            aseq.pack();
+        animation.addAnimation(clip.name.str(), aseq);
+    }
+}
+
+
+//tracks + keyframes of clip i of a cooked model, copied in one go
+void load_gem_clip(const GEMCookedModel& cooked, unsigned int i, AnimationSequence& sequence)
+{
+    GEMSpan<PackedBoneTracks> tracks = cooked.tracks(i);
+    GEMSpan<unsigned short> keyframes = cooked.keyframes(i);
+    sequence.packed.bones.assign(tracks.begin(), tracks.end());
+    sequence.packed.data.assign(keyframes.begin(), keyframes.end());
+}
+
+//skeleton + packed clips of a cooked model, keyframes = false only adds the clips' names and lengths (load_gem_clip fills them later)
+void load_gem_animation(const GEMCookedModel& cooked, Animation& animation, bool keyframes = true)
+{
+    memcpy(&animation.skeleton.globalInverse, cooked.header->global_inverse, 16 * sizeof(float));
+    animation.skeleton.bones.resize(cooked.bone_count());
+    for (unsigned int i = 0; i < cooked.bone_count(); i++)
+    {
+        Bone& bone = animation.skeleton.bones[i];
+        bone.name = cooked.str(cooked.bone(i).name);
+        memcpy(&bone.offset, cooked.bone(i).offset, 16 * sizeof(float));
+        bone.parentIndex = cooked.bone(i).parent_index;
+    }
+    animation.skeleton.buildIndex();
+
+    for (unsigned int i = 0; i < cooked.clip_count(); i++)
+    {
+        const GEMCookedClip& clip = cooked.clip(i);
+        AnimationSequence aseq;
+        aseq.ticksPerSecond = clip.ticks_per_second;
+        if (keyframes)
+            load_gem_clip(cooked, i, aseq);
+        aseq.packed.frame_count = clip.frame_count;
+        aseq.packed.stride = clip.stride;
+        animation.addAnimation(cooked.str(clip.name), aseq);
+    }
+}
+
+
+//everything init_meshes + load_gem_animation derive from a .gem, in the .gemc layout (see gem_cooked.h)
+bool cook_gem(const std::string& filename, std::vector<char>& blob)
+{
+    GEMMappedModel gem;
+    if (!gem.open(filename))
+        return false;
+    Animation animation;
+    if (!gem.bones.empty())
+        load_gem_animation(gem, animation);
+
+    GEMCookedWriter writer;
+    writer.begin(gem.animated, gem_source_hash(gem.data(), gem.size()), gem.size(),
+        (unsigned int)gem.meshes.size(), (unsigned int)animation.skeleton.bones.size(), (unsigned int)animation.clips.size());
+    Vec3 bounds_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 bounds_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < gem.meshes.size(); i++)
+    {
+        const GEMMappedMesh& gemmesh = gem.meshes[i];
+        MaterialTable material;
+        material.parse(gemmesh.properties);
+        std::string textures[GEM_COOKED_TEXTURES] = { material.get_string(MATERIAL_ALBEDO), material.get_string(MATERIAL_NH), material.get_string(MATERIAL_RMAX) };
+        std::vector<unsigned int> indices = gemmesh.indices.to_vector();
+        if (gem.animated)
+        {
+            std::vector<ANIMATED_VERTEX> vertices(gemmesh.vertices_animated.size());
+            memcpy(vertices.data(), gemmesh.vertices_animated.data, vertices.size() * sizeof(ANIMATED_VERTEX));
+            for (const ANIMATED_VERTEX& v : vertices)
+            {
+                bounds_min = Min(bounds_min, v.pos);
+                bounds_max = Max(bounds_max, v.pos);
+            }
+            MeshOptimizer::optimize(vertices, indices);
+            writer.set_mesh(i, vertices.data(), (unsigned int)vertices.size(), indices, textures);
+        }
+        else
+        {
+            std::vector<STATIC_VERTEX> vertices(gemmesh.vertices_static.size());
+            memcpy(vertices.data(), gemmesh.vertices_static.data, vertices.size() * sizeof(STATIC_VERTEX));
+            for (const STATIC_VERTEX& v : vertices)
+            {
+                bounds_min = Min(bounds_min, v.pos);
+                bounds_max = Max(bounds_max, v.pos);
+            }
+            MeshOptimizer::optimize(vertices, indices);
+            writer.set_mesh(i, vertices.data(), (unsigned int)vertices.size(), indices, textures);
+        }
+    }
+    writer.set_bounds(bounds_min, bounds_max);
+    if (!animation.skeleton.bones.empty())
+        writer.set_skeleton(animation.skeleton);
+    for (unsigned int i = 0; i < animation.clips.size(); i++)
+        writer.set_clip(i, animation.clipNames[i], *animation.clips[i]);
+    blob.swap(writer.blob);
+    return true;
+}
+
+//the cooked form of a .gem, cooked again (and saved as .gemc next to it) when that is missing or stale
+bool load_cooked_gem(const std::string& filename, GEMCookedModel& cooked)
+{
+    GEMFileMapping source;
+    if (!source.open(filename))
+    {
+        std::cerr << "Failed to map model file: " << filename << std::endl;
+        return false;
+    }
+    uint64_t hash = gem_source_hash(source.data(), source.size());
+    uint64_t size = source.size();
+    source.close();
+    std::string cooked_name = filename.substr(0, filename.find_last_of('.')) + GEM_COOKED_EXTENSION;
+    if (cooked.open(cooked_name, hash, size))
+        return true;
+
+    std::cout << "Cooking " << filename << std::endl;
+    std::vector<char> blob;
+    if (!cook_gem(filename, blob))
+        return false;
+    std::ofstream file(cooked_name, std::ios::binary);
+    file.write(blob.data(), blob.size());
+    if (!file.good())
+        std::cerr << "Failed to write cooked model: " << cooked_name << std::endl;
+    file.close();
+    return cooked.open(std::move(blob), hash, size);
+}
+
+
+//keyframe memory of the per frame vectors vs the packed clips, decode error and full pose sampling time
+void report_animation_packing(const std::string model_name, const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+
+    Animation raw;
+    Animation packed;
+    load_gem_animation(gemanimation, raw, false);
+    load_gem_animation(gemanimation, packed, true);
+
+    size_t raw_bytes = 0;
+    size_t packed_bytes = 0;
+    unsigned int tracks = 0;
+    unsigned int animated = 0;
+    float max_position_error = 0;
+    float max_rotation_error = 0;
+    for (ClipHandle c = 0; c < (ClipHandle)raw.clips.size(); c++)
+    {
+        AnimationSequence* a = raw.clip(c);
+        AnimationSequence* b = packed.clip(c);
+        raw_bytes += a->memoryBytes();
+        packed_bytes += b->memoryBytes();
+        tracks += 3 * raw.bonesSize();
+        animated += b->packed.animated_tracks();
+        for (int f = 0; f < a->frameCount(); f++)
+        {
+            for (int bone = 0; bone < raw.bonesSize(); bone++)
+            {
+                Vec3 p, s;
+                Quaternion q;
+                b->packed.decode(f, bone, p, q, s);
+                const Quaternion& r = a->frames[f].rotations[bone];
+                float dp = fabsf(q.a * r.a + q.b * r.b + q.c * r.c + q.d * r.d) / r.Mangnitude();
+                max_position_error = max(max_position_error, (p - a->frames[f].positions[bone]).length());
+                max_rotation_error = max(max_rotation_error, 2.0f * acosf(min(dp, 1.0f)));
+            }
+        }
+    }
+
+    std::cout << model_name << " clips: " << raw.clips.size() << " bones: " << raw.bonesSize()
+        << " animated tracks: " << animated << "/" << tracks << std::endl;
+    std::cout << "  keyframes: " << raw_bytes / 1024 << " KB -> " << packed_bytes / 1024 << " KB ("
+        << (packed_bytes ? (float)raw_bytes / packed_bytes : 0) << "x)" << std::endl;
+    std::cout << "  max error: position " << max_position_error << " rotation " << max_rotation_error << " rad" << std::endl;
+
+    // full pose of every clip at a spread of times, same walk as AnimationInstance::update
+    const int samples = 200;
+    std::vector<Matrix> matrices(raw.bonesSize());
+    Animation* animations[2] = { &raw, &packed };
+    const char* labels[2] = { "vectors", "packed" };
+    for (int k = 0; k < 2; k++)
+    {
+        Animation* animation = animations[k];
+        unsigned int poses = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (ClipHandle c = 0; c < (ClipHandle)animation->clips.size(); c++)
+        {
+            AnimationSequence* sequence = animation->clip(c);
+            for (int i = 0; i < samples; i++)
+            {
+                int frame = 0;
+                float interpolationFact = 0;
+                sequence->calcFrame(sequence->duration() * i / samples, frame, interpolationFact);
+                for (int bone = 0; bone < animation->bonesSize(); bone++)
+                    matrices[bone] = sequence->interpolateBoneToGlobal(matrices.data(), frame, interpolationFact, &animation->skeleton, bone);
+                poses++;
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count();
+        std::cout << "  " << labels[k] << " sampling: " << (poses ? us / poses : 0) << " us per pose" << std::endl;
+    }
+}
+
+
+//animate 1 / 100 / 1000 copies of a model with 1..all cores, ms per frame and speedup over one thread
+void report_animation_jobs(const std::string model_name, const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+    Animation animation;
+    load_gem_animation(gemanimation, animation);
+    if (animation.clips.empty())
+    {
+        std::cerr << model_name << " has no animations" << std::endl;
+        return;
+    }
+
+    const int frames = 100;
+    const float dt = 1.0f / 60.0f;
+    unsigned int cores = max(1u, std::thread::hardware_concurrency());
+    const unsigned int counts[3] = { 1, 100, 1000 };
+    // 1, 2, 4 ... and all cores
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int threads = 1; threads < cores; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(cores);
+    for (unsigned int count : counts)
+    {
+        std::vector<AnimationInstance> instances(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            instances[i].init(&animation, 0);
+            instances[i].crossFadeTime = 0.2f;
+        }
+
+        double single_ms = 0;
+        for (unsigned int threads : thread_counts)
+        {
+            JobSystem system;
+            system.init(threads - 1);
+            AnimationJobs jobs;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int f = 0; f < frames; f++)
+            {
+                for (unsigned int i = 0; i < count; i++)
+                {
+                    // a clip change every second, spread over the instances
+                    ClipHandle clip = (ClipHandle)((i + f / 60) % animation.clips.size());
+                    jobs.add(&instances[i], clip, dt);
+                }
+                jobs.run(threads > 1 ? &system : nullptr);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+            if (threads == 1)
+                single_ms = ms;
+            std::cout << model_name << " x" << count << " threads: " << threads << " " << ms << " ms per frame"
+                << " speedup: " << (ms > 0 ? single_ms / ms : 0) << std::endl;
+        }
+    }
+}
+
+
+//baked palettes vs live sampling for a herd playing a few clips: memory, error and update time
+void report_palette_bake(const std::string model_name, const std::vector<std::string> clip_names, float rate = BAKED_PALETTE_RATE,
+    const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+    Animation animation;
+    load_gem_animation(gemanimation, animation);
+
+    std::vector<ClipHandle> clips;
+    for (const std::string& clip_name : clip_names)
+    {
+        ClipHandle clip = animation.findClip(clip_name);
+        if (animation.validClip(clip))
+            clips.push_back(clip);
+        else
+            std::cerr << model_name << " has no clip " << clip_name << std::endl;
+    }
+    if (clips.empty())
+        return;
+
+    BakedPalettes baked;
+    baked.bake(&animation, clips, rate);
+    unsigned int bones = (unsigned int)animation.bonesSize();
+    std::cout << model_name << " baked " << clips.size() << " clips at " << rate << " fps: "
+        << baked.memoryBytes() / 1024 << " KB (" << baked.palettes.size() / max(bones, 1u) << " palettes), live: "
+        << 2 * bones * sizeof(Matrix) / 1024.0f << " KB per instance" << std::endl;
+
+    // quality, at times between the baked frames, rotation/scale part and translation part apart
+    for (int lerp = 0; lerp < 2; lerp++)
+    {
+        float max_rotation = 0;
+        float max_translation = 0;
+        AnimationInstance live;
+        live.init(&animation, 0);
+        std::vector<Matrix> out(bones);
+        for (ClipHandle clip : clips)
+        {
+            float duration = animation.clip(clip)->duration();
+            for (int i = 0; i < 200; i++)
+            {
+                float t = duration * (i + 0.37f) / 200.0f;
+                live.update(clip, 0);
+                live.t = t;
+                live.update(clip, 0);
+                baked.sample(clip, t, lerp == 1, out.data());
+                for (unsigned int b = 0; b < bones; b++)
+                {
+                    for (int k = 0; k < 12; k++)
+                    {
+                        float e = fabsf(out[b].m[k] - live.matrices[b].m[k]);
+                        if (k % 4 == 3)
+                            max_translation = max(max_translation, e);
+                        else
+                            max_rotation = max(max_rotation, e);
+                    }
+                }
+            }
+        }
+        std::cout << "  " << (lerp ? "lerp" : "nearest") << " max error: rotation/scale " << max_rotation
+            << " translation " << max_translation << std::endl;
+    }
+
+    // 1000 instances on the chosen clips at random phases
+    const unsigned int count = 1000;
+    const int frames = 60;
+    const float dt = 1.0f / 60.0f;
+    const char* labels[3] = { "live", "baked nearest", "baked lerp" };
+    for (int mode = 0; mode < 3; mode++)
+    {
+        std::vector<AnimationInstance> instances(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            instances[i].init(&animation, 0);
+            instances[i].baked = mode > 0 ? &baked : nullptr;
+            instances[i].bakedLerp = mode == 2;
+            instances[i].update(clips[i % clips.size()], random_float(0.0f, 1.0f));
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int f = 0; f < frames; f++)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                instances[i].update(clips[i % clips.size()], dt);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / ((double)frames * count);
+        std::cout << "  " << labels[mode] << ": " << us << " us per instance update" << std::endl;
+    }
+}
+
+
+//CPU skinning of a model over one clip: SSE vs the float reference, decimated vs full bounds, bind pose vs animated bounds, time
+void report_cpu_skinning(const std::string model_name, const std::string clip_name, const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+    Animation animation;
+    load_gem_animation(gemanimation, animation);
+    ClipHandle clip = animation.findClip(clip_name);
+    if (!animation.validClip(clip))
+    {
+        std::cerr << model_name << " has no clip " << clip_name << std::endl;
+        return;
+    }
+
+    CpuSkinning full;
+    CpuSkinning decimated;
+    for (unsigned int i = 0; i < gemmeshes.size(); i++)
+    {
+        if (!gemmeshes[i].isAnimated())
+            continue;
+        std::vector<ANIMATED_VERTEX> vertices(gemmeshes[i].verticesAnimated.size());
+        memcpy(vertices.data(), gemmeshes[i].verticesAnimated.data(), vertices.size() * sizeof(ANIMATED_VERTEX));
+        full.add(vertices);
+        decimated.add(vertices, CPU_SKINNING_DEFAULT_STEP);
+    }
+    Vec3 bind_min = full.bounds_min;
+    Vec3 bind_max = full.bounds_max;
+    unsigned int bones = (unsigned int)animation.bonesSize();
+
+    AnimationInstance instance;
+    instance.init(&animation, 0);
+    const int samples = 60;
+    float duration = animation.clip(clip)->duration();
+    float max_error = 0;
+    float max_bounds_gap = 0;
+    float max_bind_gap = 0;
+    std::vector<Vec3> skinned;
+    for (int i = 0; i < samples; i++)
+    {
+        instance.update(clip, i == 0 ? 0.0f : duration / samples);
+        full.skin(instance.matrices, bones, skinned);
+        for (unsigned int v = 0; v < full.size(); v++)
+        {
+            Vec3 d = skinned[v] - CpuSkinning::skin_reference(instance.matrices, bones, full.vertices[v]);
+            max_error = max(max_error, max(fabsf(d.x), max(fabsf(d.y), fabsf(d.z))));
+        }
+        full.update_bounds(instance.matrices, bones);
+        decimated.update_bounds(instance.matrices, bones);
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            // how much the decimated box misses, how far the bind pose box is off
+            max_bounds_gap = max(max_bounds_gap, max(decimated.bounds_min.v[k] - full.bounds_min.v[k], full.bounds_max.v[k] - decimated.bounds_max.v[k]));
+            max_bind_gap = max(max_bind_gap, max(fabsf(bind_min.v[k] - full.bounds_min.v[k]), fabsf(bind_max.v[k] - full.bounds_max.v[k])));
+        }
+    }
+    std::cout << model_name << " " << clip_name << ": " << full.size() << " vertices, " << decimated.size() << " decimated" << std::endl;
+    std::cout << "  SSE vs reference max error: " << max_error << std::endl;
+    std::cout << "  bounds, decimated misses the full box by up to " << max_bounds_gap
+        << ", the bind pose box is off by up to " << max_bind_gap << std::endl;
+
+    const int runs = 200;
+    CpuSkinning* kernels[2] = { &full, &decimated };
+    const char* labels[2] = { "full", "decimated" };
+    for (int k = 0; k < 2; k++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < runs; r++)
+            kernels[k]->update_bounds(instance.matrices, bones);
+        auto end = std::chrono::high_resolution_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / runs;
+        std::cout << "  " << labels[k] << " bounds: " << us << " us, " << us * 1000.0 / max(kernels[k]->size(), 1u) << " ns per vertex" << std::endl;
+    }
+    Vec3 sink(0, 0, 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < runs; r++)
+    {
+        for (const SkinnedVertex& v : full.vertices)
+            sink = Max(sink, CpuSkinning::skin_reference(instance.matrices, bones, v));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double us = std::chrono::duration<double, std::micro>(end - start).count() / runs;
+    std::cout << "  full reference (float): " << us << " us, max x " << sink.x << std::endl;
+}
+
+// ground speed and turn root motion finds in every clip of a model, and what it costs
+void report_root_motion(const std::string model_name, const std::string folder = "Models/")
+{
+    GEMLoader::GEMModelLoader loader;
+    std::vector<GEMLoader::GEMMesh> gemmeshes;
+    GEMLoader::GEMAnimation gemanimation;
+    loader.load(folder + model_name + ".gem", gemmeshes, gemanimation);
+    Animation animation;
+    load_gem_animation(gemanimation, animation);
+
+    RootMotion root_motion;
+    auto start = std::chrono::high_resolution_clock::now();
+    root_motion.extract(&animation);
+    auto end = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << model_name << " root motion: " << root_motion.feet.size() << " foot bones, up axis " << root_motion.up_axis
+        << (root_motion.up_sign < 0 ? " (negative)" : "") << ", extract " << ms << " ms" << std::endl;
+    for (ClipHandle clip = 0; clip < (ClipHandle)animation.clips.size(); clip++)
+    {
+        if (!root_motion.contains(clip))
+            continue;
+        std::cout << "  " << animation.clipNames[clip] << ": " << root_motion.speed(clip) << " units/s, turn "
+            << root_motion.clips[clip].yaw.back() * 180.0f / 3.14159265f << " degrees per cycle, a foot down "
+            << (int)(root_motion.clips[clip].contact * 100.0f) << "% of the steps"
+            << (root_motion.travels(clip) ? "" : ", in place") << std::endl;
+    }
+}
+
+
+//ifstream GEMModelLoader vs the mapped loader, open only / owned copies / straight to an Animation
+void report_gem_loading(const std::string model_name, const std::string folder = "Models/", int runs = 10)
+{
+    std::string filename = folder + model_name + ".gem";
+    double ifstream_ms = 0;
+    double mapped_ms = 0;
+    double mapped_copy_ms = 0;
+    double ifstream_animation_ms = 0;
+    double mapped_animation_ms = 0;
+    size_t bytes = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            GEMLoader::GEMModelLoader loader;
+            std::vector<GEMLoader::GEMMesh> gemmeshes;
+            GEMLoader::GEMAnimation gemanimation;
+            loader.load(filename, gemmeshes, gemanimation);
+            auto loaded = std::chrono::high_resolution_clock::now();
+            ifstream_ms += std::chrono::duration<double, std::milli>(loaded - start).count();
+            Animation animation;
+            load_gem_animation(gemanimation, animation, false);
+            ifstream_animation_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        {
+            GEMMappedModel gem;
+            if (!gem.open(filename))
+                return;
+            bytes = gem.size();
+            auto opened = std::chrono::high_resolution_clock::now();
+            mapped_ms += std::chrono::duration<double, std::milli>(opened - start).count();
+            Animation animation;
+            load_gem_animation(gem, animation, false);
+            mapped_animation_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        {
+            GEMMappedModel gem;
+            gem.open(filename);
+            std::vector<GEMLoader::GEMMesh> gemmeshes;
+            GEMLoader::GEMAnimation gemanimation;
+            gem.copy_to(gemmeshes, gemanimation);
+            mapped_copy_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+    std::cout << model_name << " (" << bytes / 1024 << " KB), average of " << runs << " loads:" << std::endl;
+    std::cout << "  ifstream load: " << ifstream_ms / runs << " ms, + Animation: " << ifstream_animation_ms / runs << " ms" << std::endl;
+    std::cout << "  mapped open: " << mapped_ms / runs << " ms, + Animation: " << mapped_animation_ms / runs << " ms" << std::endl;
+    std::cout << "  mapped open + owned copies: " << mapped_copy_ms / runs << " ms" << std::endl;
+}
+
+//what init_meshes does with a .gem (weld, reorder, bounds, pack the clips) vs opening its cooked .gemc, and that both give the same data
+void report_cooked_loading(const std::string model_name, const std::string folder = "Models/", int runs = 10)
+{
+    std::string filename = folder + model_name + ".gem";
+    GEMCookedModel cooked;
+    if (!load_cooked_gem(filename, cooked))
+        return;
+
+    double gem_ms = 0;
+    double cook_ms = 0;
+    double cooked_ms = 0;
+    bool identical = true;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        GEMMappedModel gem;
+        gem.open(filename);
+        AABB bounds;
+        std::vector<std::vector<unsigned char>> vertices(gem.meshes.size());
+        std::vector<std::vector<unsigned int>> indices(gem.meshes.size());
+        for (unsigned int i = 0; i < gem.meshes.size(); i++)
+        {
+            indices[i] = gem.meshes[i].indices.to_vector();
+            if (gem.animated)
+            {
+                std::vector<ANIMATED_VERTEX> v(gem.meshes[i].vertices_animated.size());
+                memcpy(v.data(), gem.meshes[i].vertices_animated.data, v.size() * sizeof(ANIMATED_VERTEX));
+                for (const ANIMATED_VERTEX& p : v)
+                    bounds.expand(p.pos);
+                MeshOptimizer::optimize(v, indices[i]);
+                vertices[i].assign((unsigned char*)v.data(), (unsigned char*)(v.data() + v.size()));
+            }
+            else
+            {
+                std::vector<STATIC_VERTEX> v(gem.meshes[i].vertices_static.size());
+                memcpy(v.data(), gem.meshes[i].vertices_static.data, v.size() * sizeof(STATIC_VERTEX));
+                for (const STATIC_VERTEX& p : v)
+                    bounds.expand(p.pos);
+                MeshOptimizer::optimize(v, indices[i]);
+                vertices[i].assign((unsigned char*)v.data(), (unsigned char*)(v.data() + v.size()));
+            }
+        }
+        Animation animation;
+        if (!gem.bones.empty())
+            load_gem_animation(gem, animation);
+        gem_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<char> blob;
+        cook_gem(filename, blob);
+        cook_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        GEMCookedModel reopened;
+        load_cooked_gem(filename, reopened);
+        AABB cooked_bounds;
+        cooked_bounds.expand(reopened.bounds_min());
+        cooked_bounds.expand(reopened.bounds_max());
+        Animation cooked_animation;
+        if (reopened.bone_count() > 0)
+            load_gem_animation(reopened, cooked_animation);
+        cooked_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (r > 0)
+            continue;
+        identical = reopened.mesh_count() == gem.meshes.size() && cooked_animation.clips.size() == animation.clips.size()
+            && (bounds.m_min - cooked_bounds.m_min).length() == 0 && (bounds.m_max - cooked_bounds.m_max).length() == 0;
+        for (unsigned int i = 0; identical && i < reopened.mesh_count(); i++)
+        {
+            const void* data = gem.animated ? (const void*)reopened.vertices_animated(i).data : (const void*)reopened.vertices_static(i).data;
+            identical = reopened.mesh(i).vertex_count * reopened.header->vertex_size == vertices[i].size()
+                && memcmp(data, vertices[i].data(), vertices[i].size()) == 0
+                && reopened.indices(i).to_vector() == indices[i]
+                && reopened.texture(i, 0) == gem.meshes[i].find("albedo");
+        }
+        for (unsigned int i = 0; identical && i < animation.clips.size(); i++)
+        {
+            const PackedClip& a = animation.clips[i]->packed;
+            const PackedClip& b = cooked_animation.clips[i]->packed;
+            identical = animation.clipNames[i] == cooked_animation.clipNames[i] && a.data == b.data && a.stride == b.stride
+                && a.frame_count == b.frame_count && memcmp(a.bones.data(), b.bones.data(), a.bones.size() * sizeof(PackedBoneTracks)) == 0;
+        }
+    }
+    std::cout << model_name << " (" << cooked.header->mesh_count << " meshes, " << cooked.header->clip_count << " clips), average of " << runs << " loads:" << std::endl;
+    std::cout << "  from .gem (weld, reorder, bounds, pack): " << gem_ms / runs << " ms" << std::endl;
+    std::cout << "  cook: " << cook_ms / runs << " ms" << std::endl;
+    std::cout << "  from .gemc (hash the .gem, map, skeleton + clips): " << cooked_ms / runs << " ms" << std::endl;
+    std::cout << "  cooked data " << (identical ? "matches" : "DIFFERS from") << " the .gem path" << std::endl;
+}
+
+//GEMScene::load vs GEMSceneParser on a generated scene of instance_count instances, throughput in MB/s and whether both give the same scene
+void report_scene_parsing(unsigned int instance_count = 50000, const std::string filename = "Save/scene_benchmark.json", int runs = 5)
+{
+    const char* models[] = { "Models/acacia.gem", "Models/pine2.gem", "Models/flower4.gem", "Models/Fence_Wooden_Old_Full_26h.gem" };
+    {
+        std::ofstream out(filename);
+        out << "{\n  \"name\": \"benchmark\",\n  \"version\": 2,\n  \"instances\": [\n";
+        for (unsigned int i = 0; i < instance_count; i++)
+        {
+            Matrix w = Matrix::rotateY(random_float(0.0f, 2.0f * M_PI)) * Matrix::Scaling(random_float(0.5f, 2.0f));
+            w.m[3] = random_float(-500.0f, 500.0f);
+            w.m[11] = random_float(-500.0f, 500.0f);
+            out << "    {\"filename\": \"" << models[i % 4] << "\", \"world\": [";
+            for (int k = 0; k < 16; k++)
+                out << (k ? ", " : "") << w.m[k];
+            out << "], \"tint\": \"" << random_float(0, 1) << " " << random_float(0, 1) << " 1\", \"lod_bias\": " << (int)(i % 3) << ", \"shadows\": true}"
+                << (i + 1 < instance_count ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+    GEMFileMapping file;
+    if (!file.open(filename))
+        return;
+    double megabytes = file.size() / (1024.0 * 1024.0);
+
+    double tree_ms = 0;
+    double mapped_ms = 0;
+    bool identical = true;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        GEMLoader::GEMScene tree;
+        tree.load(filename);
+        tree_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        GEMLoader::GEMScene mapped;
+        GEMSceneParser parser;
+        parser.load(filename, mapped);
+        mapped_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (r > 0)
+            continue;
+        identical = tree.instances.size() == mapped.instances.size() && tree.sceneProperties.size() == mapped.sceneProperties.size();
+        for (unsigned int i = 0; identical && i < tree.sceneProperties.size(); i++)
+            identical = tree.sceneProperties[i].name == mapped.sceneProperties[i].name && tree.sceneProperties[i].value == mapped.sceneProperties[i].value;
+        for (unsigned int i = 0; identical && i < tree.instances.size(); i++)
+        {
+            const GEMLoader::GEMInstance& a = tree.instances[i];
+            const GEMLoader::GEMInstance& b = mapped.instances[i];
+            identical = a.meshFilename == b.meshFilename && memcmp(a.w.m, b.w.m, sizeof(a.w.m)) == 0
+                && a.material.properties.size() == b.material.properties.size();
+            for (unsigned int k = 0; identical && k < a.material.properties.size(); k++)
+                identical = a.material.properties[k].name == b.material.properties[k].name && a.material.properties[k].value == b.material.properties[k].value;
+        }
+    }
+    std::cout << filename << " (" << instance_count << " instances, " << megabytes << " MB), average of " << runs << " loads:" << std::endl;
+    std::cout << "  GEMScene::load (GEMJson tree): " << tree_ms / runs << " ms, " << megabytes * 1000.0 * runs / tree_ms << " MB/s" << std::endl;
+    std::cout << "  GEMSceneParser (mapped, one pass): " << mapped_ms / runs << " ms, " << megabytes * 1000.0 * runs / mapped_ms << " MB/s" << std::endl;
+    std::cout << "  scenes " << (identical ? "match" : "DIFFER") << std::endl;
+}
+
+//GEMMaterial::find + getValue (search + copy + parse per call) vs a MaterialTable parsed once, ns per lookup
+void report_material_lookup(int lookups = 1000000)
+{
+    GEMLoader::GEMMaterial material;
+    const char* properties[][2] = {
+        { "albedo", "Models/Textures/pine branch_ALB.png" }, { "nh", "Models/Textures/pine branch_NH.png" },
+        { "rmax", "Models/Textures/pine branch_RMAX.png" }, { "vertex_animation", "1" }, { "hitbox", "0" },
+        { "depth_sort", "1" }, { "tint", "0.8 0.9 1" }, { "lod_bias", "2" } };
+    for (const auto& p : properties)
+    {
+        GEMLoader::GEMProperty property(p[0]);
+        property.value = p[1];
+        material.properties.push_back(property);
+    }
+
+    float sum = 0;
+    size_t length = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < lookups; i++)
+    {
+        length += material.find("albedo").getValue().size();
+        sum += material.find("depth_sort").getValue(0.0f);
+        float x, y, z;
+        material.find("tint").getValuesAsVector3(x, y, z);
+        sum += x + y + z;
+    }
+    double find_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    MaterialTable table;
+    table.parse(material);
+    double parse_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < lookups; i++)
+    {
+        length += table.get_string_id(MATERIAL_ALBEDO);
+        sum += table.get_float(MATERIAL_DEPTH_SORT);
+        Vec3 tint = table.get_vec3(MATERIAL_TINT);
+        sum += tint.x + tint.y + tint.z;
+    }
+    double table_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    bool same = table.get_string(MATERIAL_ALBEDO) == material.find("albedo").getValue() && table.get_float(MATERIAL_DEPTH_SORT) == material.find("depth_sort").getValue(0.0f)
+        && table.unknown == 1;
+    std::cout << "Material lookups (albedo + depth_sort + tint) x " << lookups << ", " << material.properties.size() << " properties:" << std::endl;
+    std::cout << "  GEMMaterial::find + getValue: " << find_ms * 1e6 / (lookups * 3.0) << " ns per lookup" << std::endl;
+    std::cout << "  MaterialTable: " << table_ms * 1e6 / (lookups * 3.0) << " ns per lookup, parsed once in " << parse_ms * 1000.0 << " us" << std::endl;
+    std::cout << "  values " << (same ? "match" : "DIFFER") << " (checksum " << sum + length << ")" << std::endl;
+}
@@ -1,38 +1,107 @@
 #pragma once
 #include "model.h"
+#include "asset_loader.h"
 
 class Item_Ins_Base
 {
 public:
 	Object_Instance model;
 	std::string name;
+	// the instance file, "" for scene batches
+	std::string matrix_file;
 	std::vector<AABB> world_hitboxs;
+	// all of world_hitboxs, tested first
+	AABB world_bounds;
 	Matrix model_adjust;
 
 	void init(Core* core, Shader_Manager* shader_manager, PSOManager* psos, 
-		Texture_Manager* textures, std::string model_name, std::string matrix_file_name, bool if_VS_ani, bool if_hitbox)
+		Texture_Manager* textures, std::string model_name, std::string matrix_file_name, bool if_VS_ani, bool if_hitbox, AssetLoader* assets = nullptr)
 	{
 		model_adjust = model_adjust.mul(Matrix::rotateY(M_PI / 2));
 		
 		//create_matixes(model.instances_matix, Vec3(0, 0, 0), 3800.0f, 3800.0f, 1, 1.2);
 		//model.instances_matix = generateFenceRectangle(Vec3(0, 0, 0), 3800.0f, 3800.0f, 100.0f, Vec3(100, 100, 100), model_adjust);
 		//save_instance_matrices(FILE_NAME_FLOWER_MATRIX, model.instances_matix);
-		load_instance_matrices(matrix_file_name, model.instances_matix);
+		matrix_file = matrix_file_name;
+		if (!assets || !assets->take_instances(matrix_file_name, model.instances_matix))
+			load_instance_matrices(matrix_file_name, model.instances_matix);
 
+		init_instances(core, shader_manager, psos, textures, model_name, if_VS_ani, if_hitbox);
+	}
+
+	//model.instances_matix is filled already (scene batches)
+	void init_instances(Core* core, Shader_Manager* shader_manager, PSOManager* psos,
+		Texture_Manager* textures, std::string model_name, bool if_VS_ani, bool if_hitbox)
+	{
+		name = model_name;
 		model.init(core, shader_manager, psos, textures, model_name, if_VS_ani);
 		model.init_hitbox(core, shader_manager, psos, if_hitbox);
 
+		update_hitboxes();
+	}
+
+	void update_hitboxes()
+	{
+		world_hitboxs.clear();
+		world_hitboxs.reserve(model.instances_matix.size());
 		for (unsigned int i = 0; i < model.instances_matix.size(); i++)
 		{
 			//model.instances_matix[i].w = model.instances_matix[i].w.mul(model_adjust);
 			AABB world = model.hitbox.local_aabb;
 			world_hitboxs.push_back(world.transform(model.instances_matix[i].w));
 		}
+		update_world_bounds();
+	}
 
+	void update_world_bounds()
+	{
+		world_bounds.reset();
+		for (const AABB& w : world_hitboxs)
+			world_bounds.expand(w);
+	}
+
+	//hot reload: new matrices, only instances that moved (or are new) get their hitbox transformed again, returns how many did
+	unsigned int set_instances(Core* core, std::vector<INSTANCE>& instances)
+	{
+		unsigned int moved = 0;
+		size_t kept = min(instances.size(), model.instances_matix.size());
+		world_hitboxs.resize(instances.size());
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			if (i < kept && memcmp(instances[i].w.m, model.instances_matix[i].w.m, sizeof(instances[i].w.m)) == 0)
+				continue;
+			world_hitboxs[i] = model.hitbox.local_aabb.transform(instances[i].w);
+			moved++;
+		}
+		model.set_instances(core, instances);
+		update_world_bounds();
+		return moved;
+	}
+
+	//hot reload of the model's .gem: new meshes + bounds, every hitbox follows the new bounds
+	bool reload_model(Core* core)
+	{
+		if (!model.reload_meshes(core))
+			return false;
+		if (model.hitbox.ifdraw)
+		{
+			model.hitbox.mesh.free();
+			model.hitbox.init_withmesh(core, model.shader_manager, model.psos, model.hitbox.local_aabb);
+		}
+		update_hitboxes();
+		return true;
+	}
+
+	//alpha foliage, draw the visible instances back to front
+	void enable_depth_sort(Core* core)
+	{
+		model.enable_depth_sort(core);
 	}
 
 	bool collide(const AABB& aabb) const
 	{
+		if (world_hitboxs.empty() || !aabb.intersects_toother(world_bounds))
+			return false;
 		for (const auto& w : world_hitboxs)
 		{
 			if (aabb.intersects_toother(w))
@@ -46,6 +115,8 @@ public:
 	{
 		for (auto item : items)
 		{
+			if (item->world_hitboxs.empty() || !testBox.intersects_toother(item->world_bounds))
+				continue;
 			for (const AABB& test : item->world_hitboxs)
 			{
 				if (testBox.intersects_toother(test))
@@ -74,14 +145,17 @@ class Ground_Grid
 public:
 	Object_Instance grounds;
 	std::string name;
+	std::string matrix_file;
 	Matrix model_adjust;
 
 	void init(Core* core, PSOManager* _psos, Shader_Manager* _shader_manager, Texture_Manager* _textures,
-		std::string filename, std::string matrix_file_name, bool if_VS_ani, bool if_PS_trans)
+		std::string filename, std::string matrix_file_name, bool if_VS_ani, bool if_PS_trans, AssetLoader* assets = nullptr)
 	{
 		//grounds.instances_matix = generateGroundGrid(Vec3(0, 0, 0), 4000.0f, 4000.0f, 200.0f, Vec3(1, 1, 1), Matrix());
 		//save_instance_matrices(FILE_NAME_GROUND_MATRIX, grounds.instances_matix);
-		load_instance_matrices(matrix_file_name, grounds.instances_matix);
+		matrix_file = matrix_file_name;
+		if (!assets || !assets->take_instances(matrix_file_name, grounds.instances_matix))
+			load_instance_matrices(matrix_file_name, grounds.instances_matix);
 		
 		grounds.init_my_mesh(core, _shader_manager, _psos, _textures, filename, if_VS_ani, if_PS_trans);
 
@@ -0,0 +1,235 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+#include <mutex>
+#include "vectors.h"
+#include "GEMLoader.h"
+#include "gem_mapped.h"
+
+//Material property table
+/*
+– the material keys the engine reads are an enum, each with one type: float, Vec3 ("x y z") or string
+– MaterialTable::parse() reads the name / value strings once at load, after that a lookup is an array index:
+	• floats + vectors are parsed then (strtof, no exceptions), a value that is no number reads as missing, get_*() give the default
+	• strings are interned in MaterialStrings, the table keeps an id, equal strings have equal ids
+– keys the enum does not know are skipped, unknown counts them
+– MaterialStrings is one pool for the program (ModelRegistry style get()), intern() locks since the .gem cooking runs on the job system
+*/
+
+enum Material_Key
+{
+	MATERIAL_ALBEDO = 0,
+	MATERIAL_NH,
+	MATERIAL_RMAX,
+	MATERIAL_VERTEX_ANIMATION,
+	MATERIAL_HITBOX,
+	MATERIAL_DEPTH_SORT,
+	MATERIAL_TINT,
+	MATERIAL_KEY_COUNT
+};
+
+enum Material_Type
+{
+	MATERIAL_FLOAT = 0,
+	MATERIAL_VEC3,
+	MATERIAL_STRING
+};
+
+struct MaterialKeyInfo
+{
+	const char* name;
+	Material_Type type;
+};
+
+inline const MaterialKeyInfo& material_key_info(Material_Key key)
+{
+	static const MaterialKeyInfo keys[MATERIAL_KEY_COUNT] = {
+		{ "albedo", MATERIAL_STRING },
+		{ "nh", MATERIAL_STRING },
+		{ "rmax", MATERIAL_STRING },
+		{ "vertex_animation", MATERIAL_FLOAT },
+		{ "hitbox", MATERIAL_FLOAT },
+		{ "depth_sort", MATERIAL_FLOAT },
+		{ "tint", MATERIAL_VEC3 },
+	};
+	return keys[key];
+}
+
+//name -> key, false for a name the enum does not have
+inline bool material_key(const char* name, size_t length, Material_Key& key)
+{
+	for (int k = 0; k < MATERIAL_KEY_COUNT; k++)
+	{
+		const char* known = material_key_info((Material_Key)k).name;
+		if (strlen(known) == length && memcmp(known, name, length) == 0)
+		{
+			key = (Material_Key)k;
+			return true;
+		}
+	}
+	return false;
+}
+
+//interned material strings, id 0 is ""
+class MaterialStrings
+{
+public:
+	static MaterialStrings& get()
+	{
+		static MaterialStrings strings;
+		return strings;
+	}
+
+	unsigned int intern(const char* s, size_t length)
+	{
+		if (length == 0)
+			return 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		lookup.assign(s, length);
+		auto found = ids.find(lookup);
+		if (found != ids.end())
+			return found->second;
+		unsigned int id = (unsigned int)strings.size();
+		strings.push_back(lookup);
+		ids[lookup] = id;
+		return id;
+	}
+
+	unsigned int intern(const std::string& s)
+	{
+		return intern(s.data(), s.size());
+	}
+
+	//the deque never moves its strings, the reference stays valid
+	const std::string& str(unsigned int id)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return id < strings.size() ? strings[id] : strings[0];
+	}
+
+	unsigned int size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return (unsigned int)strings.size();
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<std::string> strings = { std::string() };
+	std::unordered_map<std::string, unsigned int> ids;
+	// reused for the map lookup
+	std::string lookup;
+};
+
+struct MaterialValue
+{
+	bool set = false;
+	float v[3] = { 0, 0, 0 };
+	unsigned int string_id = 0;
+};
+
+class MaterialTable
+{
+public:
+	MaterialValue values[MATERIAL_KEY_COUNT];
+	// properties with a name the enum does not have
+	unsigned int unknown = 0;
+
+	void parse(const GEMLoader::GEMMaterial& material)
+	{
+		for (const GEMLoader::GEMProperty& p : material.properties)
+			set(p.name.data(), p.name.size(), p.value.data(), p.value.size());
+	}
+
+	void parse(const std::vector<GEMMappedProperty>& properties)
+	{
+		for (const GEMMappedProperty& p : properties)
+			set(p.name.data, p.name.length, p.value.data, strnlen(p.value.data, p.value.length));
+	}
+
+	void set(const char* name, size_t name_length, const char* value, size_t value_length)
+	{
+		Material_Key key;
+		if (!material_key(name, name_length, key))
+		{
+			unknown++;
+			return;
+		}
+		MaterialValue& out = values[key];
+		out = MaterialValue();
+		out.set = true;
+		Material_Type type = material_key_info(key).type;
+		if (type == MATERIAL_STRING)
+		{
+			out.string_id = MaterialStrings::get().intern(value, value_length);
+			return;
+		}
+		// strtof wants a terminated string, three numbers fit
+		char text[64];
+		size_t length = value_length < sizeof(text) - 1 ? value_length : sizeof(text) - 1;
+		memcpy(text, value, length);
+		text[length] = 0;
+		const char* p = text;
+		unsigned int count = type == MATERIAL_VEC3 ? 3 : 1;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			char* end;
+			float v = strtof(p, &end);
+			if (end == p)
+			{
+				// not even one number, read as missing
+				out.set = i > 0;
+				break;
+			}
+			out.v[i] = v;
+			p = end;
+		}
+	}
+
+	bool has(Material_Key key) const
+	{
+		return values[key].set;
+	}
+
+	float get_float(Material_Key key, float _default = 0) const
+	{
+		return values[key].set ? values[key].v[0] : _default;
+	}
+
+	bool get_bool(Material_Key key, bool _default = false) const
+	{
+		return values[key].set ? values[key].v[0] != 0 : _default;
+	}
+
+	Vec3 get_vec3(Material_Key key, const Vec3& _default = Vec3(0, 0, 0)) const
+	{
+		return values[key].set ? Vec3(values[key].v[0], values[key].v[1], values[key].v[2]) : _default;
+	}
+
+	unsigned int get_string_id(Material_Key key) const
+	{
+		return values[key].string_id;
+	}
+
+	const std::string& get_string(Material_Key key) const
+	{
+		return MaterialStrings::get().str(values[key].string_id);
+	}
+
+	//same values for every key, unknown properties are not compared
+	bool operator==(const MaterialTable& other) const
+	{
+		for (int k = 0; k < MATERIAL_KEY_COUNT; k++)
+		{
+			const MaterialValue& a = values[k];
+			const MaterialValue& b = other.values[k];
+			if (a.set != b.set || a.string_id != b.string_id || memcmp(a.v, b.v, sizeof(a.v)) != 0)
+				return false;
+		}
+		return true;
+	}
+};
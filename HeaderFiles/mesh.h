@@ -4,29 +4,44 @@
 #include "core.h"
 #include "vertexLayoutCache.h"
 #include "GEMLoader.h"
+#include "index_buffer.h"
 
 struct INSTANCE
 {
 	Matrix w;
 };
 
+// matches the swap chain BufferCount in Core
+#define INSTANCE_FRAMES_IN_FLIGHT 2
+
 
 class Mesh
 {
 public:
 
-	ID3D12Resource* vertexBuffer;
-	ID3D12Resource* indexBuffer;
+	ID3D12Resource* vertexBuffer = nullptr;
+	ID3D12Resource* indexBuffer = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW vbView;
 	D3D12_INDEX_BUFFER_VIEW ibView;
 	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
 	unsigned int numMeshIndices;
+	// one draw per chunk, more than one only for split 16-bit meshes
+	std::vector<IndexChunk> chunks;
 
 	Mesh() {}
 
-	void init(Core* core, void* vertices, int vertexSizeInBytes, int numVertices,
-		unsigned int* indices, int numIndices)
+	void init(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices,
+		const unsigned int* indices, int numIndices)
 	{
+		//narrow to 16-bit indices (and split into chunks) when possible
+		IndexBufferData indexData;
+		IndexBufferBuilder::build(vertices, vertexSizeInBytes, numVertices, indices, numIndices, indexData);
+		const void* vertexUpload = indexData.vertexData(vertices);
+		numVertices = indexData.numVertices;
+		numIndices = indexData.numIndices(numIndices);
+		unsigned int indexSizeInBytes = indexData.indexSizeInBytes();
+		chunks = indexData.chunks;
+
 		//Specify vertex buffer will be in GPU memory heap
 		D3D12_HEAP_PROPERTIES heapprops = {};
 		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -48,7 +63,7 @@ public:
 		core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &vbDesc,
 			D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&vertexBuffer));
 		//Copy vertices using our helper function
-		core->uploadResource(vertexBuffer, vertices, numVertices * vertexSizeInBytes,
+		core->uploadResource(vertexBuffer, vertexUpload, numVertices * vertexSizeInBytes,
 			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
 		//Fill in view in helper function
@@ -58,7 +73,7 @@ public:
 
 		D3D12_RESOURCE_DESC ibDesc;
 		memset(&ibDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		ibDesc.Width = numIndices * sizeof(unsigned int);
+		ibDesc.Width = numIndices * indexSizeInBytes;
 		ibDesc.Height = 1;
 		ibDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		ibDesc.DepthOrArraySize = 1;
@@ -68,12 +83,12 @@ public:
 		ibDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 		HRESULT hr = core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &ibDesc,
 			D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&indexBuffer));
-		core->uploadResource(indexBuffer, indices, numIndices * sizeof(unsigned int),
+		core->uploadResource(indexBuffer, indexData.indexData(indices), numIndices * indexSizeInBytes,
 			D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
 		ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-		ibView.Format = DXGI_FORMAT_R32_UINT;
-		ibView.SizeInBytes = numIndices * sizeof(unsigned int);
+		ibView.Format = indexData.is16Bit ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		ibView.SizeInBytes = numIndices * indexSizeInBytes;
 		numMeshIndices = numIndices;
 	}
 
@@ -89,6 +104,19 @@ public:
 		inputLayoutDesc = VertexLayoutCache::getAnimatedLayout();
 	}
 
+	//straight from memory the caller keeps (a mapped cooked model), nothing is copied on the way to the upload
+	void init(Core* core, const STATIC_VERTEX* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices)
+	{
+		init(core, (const void*)vertices, sizeof(STATIC_VERTEX), numVertices, indices, numIndices);
+		inputLayoutDesc = VertexLayoutCache::getStaticLayout();
+	}
+
+	void init_animation(Core* core, const ANIMATED_VERTEX* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices)
+	{
+		init(core, (const void*)vertices, sizeof(ANIMATED_VERTEX), numVertices, indices, numIndices);
+		inputLayoutDesc = VertexLayoutCache::getAnimatedLayout();
+	}
+
 	void init_line(Core* core, std::vector<LINE_VERTEX> vertices, std::vector<unsigned int> indices)
 	{
 		init(core, &vertices[0], sizeof(LINE_VERTEX), vertices.size(), &indices[0], indices.size());
@@ -100,12 +128,27 @@ public:
 		inputLayoutDesc = VertexLayoutCache::getUILayout();
 	}
 
+	//the GPU has to be done with the buffers first (Core::flushGraphicsQueue)
+	void free()
+	{
+		if (vertexBuffer)
+			vertexBuffer->Release();
+		if (indexBuffer)
+			indexBuffer->Release();
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		chunks.clear();
+	}
+
 	void draw(Core* core)
 	{
 		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
 		core->getCommandList()->IASetIndexBuffer(&ibView);
-		core->getCommandList()->DrawIndexedInstanced(numMeshIndices, 1, 0, 0, 0);
+		for (const IndexChunk& chunk : chunks)
+		{
+			core->getCommandList()->DrawIndexedInstanced(chunk.indexCount, 1, chunk.startIndex, chunk.baseVertex, 0);
+		}
 	}
 
 	void draw_line(Core* core)
@@ -113,7 +156,10 @@ public:
 		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
 		core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
 		core->getCommandList()->IASetIndexBuffer(&ibView);
-		core->getCommandList()->DrawIndexedInstanced(numMeshIndices, 1, 0, 0, 0);
+		for (const IndexChunk& chunk : chunks)
+		{
+			core->getCommandList()->DrawIndexedInstanced(chunk.indexCount, 1, chunk.startIndex, chunk.baseVertex, 0);
+		}
 	}
 };
 
@@ -121,9 +167,12 @@ class Mesh_Istancing
 {
 public:
 
-	ID3D12Resource* vertexBuffer;
-	ID3D12Resource* indexBuffer;
-	ID3D12Resource* instanceBuffer;
+	ID3D12Resource* vertexBuffer = nullptr;
+	ID3D12Resource* indexBuffer = nullptr;
+	ID3D12Resource* instanceBuffer = nullptr;
+	// upload heap copy, one slice per frame in flight, for instance data rewritten every frame
+	ID3D12Resource* dynamicInstanceBuffer = nullptr;
+	unsigned char* dynamicInstanceData = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW vbView;
 	D3D12_VERTEX_BUFFER_VIEW instanceView;
 	D3D12_INDEX_BUFFER_VIEW ibView;
@@ -132,6 +181,8 @@ public:
 	unsigned int instanceSizeInBytes = sizeof(INSTANCE);
 	unsigned int numInstances;
 	unsigned int maxInstances;
+	// one draw per chunk, more than one only for split 16-bit meshes
+	std::vector<IndexChunk> chunks;
 
 	void init_instance_buffer(Core* core, std::vector<INSTANCE>& instances, unsigned int maxInstanceCount)
 	{
@@ -167,9 +218,18 @@ public:
 		update_instance_matix(core, instances);
 	}
 
-	void init(Core* core, void* vertices, int vertexSizeInBytes, int numVertices,
-		unsigned int* indices, int numIndices, std::vector<INSTANCE>& instances, unsigned int maxInstanceNum)
+	void init(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices,
+		const unsigned int* indices, int numIndices, std::vector<INSTANCE>& instances, unsigned int maxInstanceNum)
 	{
+		//narrow to 16-bit indices (and split into chunks) when possible
+		IndexBufferData indexData;
+		IndexBufferBuilder::build(vertices, vertexSizeInBytes, numVertices, indices, numIndices, indexData);
+		const void* vertexUpload = indexData.vertexData(vertices);
+		numVertices = indexData.numVertices;
+		numIndices = indexData.numIndices(numIndices);
+		unsigned int indexSizeInBytes = indexData.indexSizeInBytes();
+		chunks = indexData.chunks;
+
 		//Specify vertex buffer will be in GPU memory heap
 		D3D12_HEAP_PROPERTIES heapprops = {};
 		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -191,7 +251,7 @@ public:
 		core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &vbDesc,
 			D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&vertexBuffer));
 		//Copy vertices using our helper function
-		core->uploadResource(vertexBuffer, vertices, numVertices * vertexSizeInBytes,
+		core->uploadResource(vertexBuffer, vertexUpload, numVertices * vertexSizeInBytes,
 			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
 		//Fill in view in helper function
@@ -201,7 +261,7 @@ public:
 
 		D3D12_RESOURCE_DESC ibDesc;
 		memset(&ibDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		ibDesc.Width = numIndices * sizeof(unsigned int);
+		ibDesc.Width = numIndices * indexSizeInBytes;
 		ibDesc.Height = 1;
 		ibDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		ibDesc.DepthOrArraySize = 1;
@@ -211,12 +271,12 @@ public:
 		ibDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 		HRESULT hr = core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &ibDesc,
 			D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&indexBuffer));
-		core->uploadResource(indexBuffer, indices, numIndices * sizeof(unsigned int),
+		core->uploadResource(indexBuffer, indexData.indexData(indices), numIndices * indexSizeInBytes,
 			D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
 		ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-		ibView.Format = DXGI_FORMAT_R32_UINT;
-		ibView.SizeInBytes = numIndices * sizeof(unsigned int);
+		ibView.Format = indexData.is16Bit ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		ibView.SizeInBytes = numIndices * indexSizeInBytes;
 		numMeshIndices = numIndices;
 
 		init_instance_buffer(core, instances, maxInstanceNum);
@@ -228,18 +288,120 @@ public:
 		inputLayoutDesc = VertexLayoutCache::getStatictLayoutInstanced();
 	}
 
+	//straight from memory the caller keeps (a mapped cooked model)
+	void init(Core* core, const STATIC_VERTEX* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices, std::vector<INSTANCE>& instances, unsigned int maxInstanceNum = 1000)
+	{
+		init(core, (const void*)vertices, sizeof(STATIC_VERTEX), numVertices, indices, numIndices, instances, maxInstanceNum);
+		inputLayoutDesc = VertexLayoutCache::getStatictLayoutInstanced();
+	}
+
 	void init_animation(Core* core, std::vector<ANIMATED_VERTEX> vertices, std::vector<unsigned int> indices, std::vector<INSTANCE>& instances, unsigned int maxInstanceNum = 1000)
 	{
 		init(core, &vertices[0], sizeof(ANIMATED_VERTEX), vertices.size(), &indices[0], indices.size(), instances, maxInstanceNum);
 		inputLayoutDesc = VertexLayoutCache::getStatictLayoutInstanced();
 	}
 
+	//the vertex + index buffers of a shared static Mesh (ModelRegistry), only the instance buffer is this one's
+	//free() leaves geometry alone, its owner frees it after every user is done
+	void init(Core* core, const Mesh* geometry, std::vector<INSTANCE>& instances, unsigned int maxInstanceNum = 1000)
+	{
+		vbView = geometry->vbView;
+		ibView = geometry->ibView;
+		numMeshIndices = geometry->numMeshIndices;
+		chunks = geometry->chunks;
+		inputLayoutDesc = VertexLayoutCache::getStatictLayoutInstanced();
+		init_instance_buffer(core, instances, maxInstanceNum);
+	}
+
 	void update_instance_matix(Core* core, std::vector<INSTANCE>& instances)
 	{
-		numInstances = instances.size();
+		numInstances = min((unsigned int)instances.size(), maxInstances);
+		if (numInstances == 0)
+			return;
 		core->uploadResource(instanceBuffer, instances.data(), numInstances * instanceSizeInBytes,
 			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 	}
+
+	//hot reload: new instance data, a buffer that is too small is made again (+ the per frame one), the GPU has to be done with them
+	void set_instances(Core* core, std::vector<INSTANCE>& instances)
+	{
+		if (instances.size() <= maxInstances)
+		{
+			update_instance_matix(core, instances);
+			return;
+		}
+		bool dynamic = dynamicInstanceBuffer != nullptr;
+		free_instances();
+		init_instance_buffer(core, instances, instances.size() + 10);
+		if (dynamic)
+			init_dynamic_instance_buffer(core);
+	}
+
+	//the GPU has to be done with the buffers first (Core::flushGraphicsQueue)
+	void free()
+	{
+		if (vertexBuffer)
+			vertexBuffer->Release();
+		if (indexBuffer)
+			indexBuffer->Release();
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		chunks.clear();
+		free_instances();
+	}
+
+	void free_instances()
+	{
+		if (instanceBuffer)
+			instanceBuffer->Release();
+		if (dynamicInstanceBuffer)
+			dynamicInstanceBuffer->Release();
+		instanceBuffer = nullptr;
+		dynamicInstanceBuffer = nullptr;
+		dynamicInstanceData = nullptr;
+	}
+
+	//– uploadResource flushes the queue, fine at init but not every frame
+	//– mapped upload heap instead, the slice of the current back buffer is free once beginFrame has waited on its fence
+	void init_dynamic_instance_buffer(Core* core)
+	{
+		D3D12_HEAP_PROPERTIES heapProps = {};
+		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heapProps.CreationNodeMask = 1;
+		heapProps.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC instanceBufferDesc = {};
+		instanceBufferDesc.Width = maxInstances * instanceSizeInBytes * INSTANCE_FRAMES_IN_FLIGHT;
+		instanceBufferDesc.Height = 1;
+		instanceBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		instanceBufferDesc.DepthOrArraySize = 1;
+		instanceBufferDesc.MipLevels = 1;
+		instanceBufferDesc.SampleDesc.Count = 1;
+		instanceBufferDesc.SampleDesc.Quality = 0;
+		instanceBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		HRESULT hr = core->device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &instanceBufferDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&dynamicInstanceBuffer));
+
+		if (FAILED(hr)) {
+			dynamicInstanceBuffer = nullptr;
+			return;
+		}
+		dynamicInstanceBuffer->Map(0, NULL, (void**)&dynamicInstanceData);
+	}
+
+	void update_instance_matix_dynamic(Core* core, const INSTANCE* instances, unsigned int count)
+	{
+		if (!dynamicInstanceData)
+			return;
+		count = min(count, maxInstances);
+		unsigned int sliceOffset = core->frameIndex() * maxInstances * instanceSizeInBytes;
+		memcpy(dynamicInstanceData + sliceOffset, instances, count * instanceSizeInBytes);
+
+		instanceView.BufferLocation = dynamicInstanceBuffer->GetGPUVirtualAddress() + sliceOffset;
+		instanceView.SizeInBytes = max(count, 1u) * instanceSizeInBytes;
+		numInstances = count;
+	}
 	void draw(Core* core)
 	{
 		D3D12_VERTEX_BUFFER_VIEW bufferViews[2];
@@ -248,6 +410,9 @@ public:
 		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		core->getCommandList()->IASetVertexBuffers(0, 2, bufferViews);
 		core->getCommandList()->IASetIndexBuffer(&ibView);
-		core->getCommandList()->DrawIndexedInstanced(numMeshIndices, numInstances, 0, 0, 0);
+		for (const IndexChunk& chunk : chunks)
+		{
+			core->getCommandList()->DrawIndexedInstanced(chunk.indexCount, numInstances, chunk.startIndex, chunk.baseVertex, 0);
+		}
 	}
 };
\ No newline at end of file
@@ -0,0 +1,452 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include "vectors.h"
+
+//Mesh optimisation before upload
+/*
+GEM meshes come out of the exporter as plain triangle lists:
+– duplicated vertices (one per face corner)
+– triangles in authoring order, bad for the post-transform cache
+– vertex buffer order unrelated to the index order
+
+Stages (in this order, each one keeps the mesh identical on screen):
+1. weld duplicate vertices (byte exact)
+2. Forsyth vertex cache reordering of the triangles
+3. overdraw ordering of triangle clusters (outside facing clusters first)
+4. vertex fetch reordering (vertices in order of first use)
+
+ACMR = average cache miss ratio = transformed vertices / triangles
+– 3.0 is the worst case, ~0.5-0.7 is what a good mesh reaches
+
+The .gemc cache holds the output: a change to it needs GEM_COOKER_VERSION (gem_cooked.h) bumped
+*/
+
+// size of the FIFO cache used to measure ACMR
+#define MESH_OPT_FIFO_CACHE_SIZE 16
+// size of the LRU cache used for the Forsyth scoring
+#define MESH_OPT_LRU_CACHE_SIZE 32
+// a triangle order is kept by the overdraw stage only if ACMR gets no worse than this factor
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+struct MeshOptimizeReport
+{
+	unsigned int vertices_in = 0;
+	unsigned int vertices_out = 0;
+	unsigned int triangles = 0;
+
+	float acmr_input = 0;
+	float acmr_weld = 0;
+	float acmr_vertex_cache = 0;
+	float acmr_overdraw = 0;
+	float acmr_vertex_fetch = 0;
+
+	void print(const std::string& name) const
+	{
+		std::cout << name << ": tris " << triangles
+			<< ", verts " << vertices_in << " -> " << vertices_out
+			<< ", ACMR input " << acmr_input
+			<< " | weld " << acmr_weld
+			<< " | vertex cache " << acmr_vertex_cache
+			<< " | overdraw " << acmr_overdraw
+			<< " | vertex fetch " << acmr_vertex_fetch << std::endl;
+	}
+};
+
+class MeshOptimizer
+{
+public:
+	//simulate a FIFO post-transform cache, return misses per triangle
+	static float compute_acmr(const std::vector<unsigned int>& indices, unsigned int numVertices,
+		unsigned int cacheSize = MESH_OPT_FIFO_CACHE_SIZE)
+	{
+		if (indices.size() < 3)
+			return 0.0f;
+
+		// timestamp of the moment each vertex entered the cache
+		std::vector<unsigned int> cache_time(numVertices, 0);
+		unsigned int time = cacheSize + 1;
+		unsigned int misses = 0;
+
+		for (unsigned int index : indices)
+		{
+			if (time - cache_time[index] > cacheSize)
+			{
+				cache_time[index] = time;
+				time++;
+				misses++;
+			}
+		}
+		return (float)misses / (float)(indices.size() / 3);
+	}
+
+	//merge vertices that are byte identical, indices are remapped
+	template<typename VERTEX>
+	static void weld_vertices(std::vector<VERTEX>& vertices, std::vector<unsigned int>& indices)
+	{
+		struct VertexHasher
+		{
+			const std::vector<VERTEX>* verts;
+			size_t operator()(unsigned int i) const
+			{
+				// FNV-1a over the raw bytes
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&(*verts)[i]);
+				size_t h = 14695981039346656037ull;
+				for (size_t b = 0; b < sizeof(VERTEX); b++)
+				{
+					h ^= bytes[b];
+					h *= 1099511628211ull;
+				}
+				return h;
+			}
+		};
+		struct VertexEqual
+		{
+			const std::vector<VERTEX>* verts;
+			bool operator()(unsigned int a, unsigned int b) const
+			{
+				return memcmp(&(*verts)[a], &(*verts)[b], sizeof(VERTEX)) == 0;
+			}
+		};
+
+		std::unordered_map<unsigned int, unsigned int, VertexHasher, VertexEqual> unique(
+			vertices.size(), VertexHasher{ &vertices }, VertexEqual{ &vertices });
+
+		std::vector<unsigned int> remap(vertices.size());
+		std::vector<VERTEX> welded;
+		welded.reserve(vertices.size());
+
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			auto found = unique.find(i);
+			if (found != unique.end())
+			{
+				remap[i] = found->second;
+			}
+			else
+			{
+				remap[i] = (unsigned int)welded.size();
+				unique.insert({ i, remap[i] });
+				welded.push_back(vertices[i]);
+			}
+		}
+
+		for (unsigned int& index : indices)
+		{
+			index = remap[index];
+		}
+		vertices.swap(welded);
+	}
+
+	//Tom Forsyth "Linear-Speed Vertex Cache Optimisation"
+	//greedy: always emit the triangle with the best score among those touching the cache
+	static void optimize_vertex_cache(std::vector<unsigned int>& indices, unsigned int numVertices)
+	{
+		unsigned int numTriangles = (unsigned int)indices.size() / 3;
+		if (numTriangles == 0)
+			return;
+
+		// vertex -> triangles adjacency
+		std::vector<unsigned int> live_count(numVertices, 0);
+		for (unsigned int index : indices)
+		{
+			live_count[index]++;
+		}
+		std::vector<unsigned int> adjacency_offset(numVertices + 1, 0);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			adjacency_offset[v + 1] = adjacency_offset[v] + live_count[v];
+		}
+		std::vector<unsigned int> adjacency(indices.size());
+		std::vector<unsigned int> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+			}
+		}
+
+		std::vector<int> cache_position(numVertices, -1);
+		std::vector<float> vertex_score(numVertices, 0.0f);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			vertex_score[v] = forsyth_score(-1, live_count[v]);
+		}
+
+		std::vector<bool> emitted(numTriangles, false);
+
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+
+		// LRU cache, front is the most recent, a few extra slots for the triangle being pushed
+		std::vector<unsigned int> cache;
+		cache.reserve(MESH_OPT_LRU_CACHE_SIZE + 3);
+		// cache after the push, reused for every triangle
+		std::vector<unsigned int> new_cache;
+		new_cache.reserve(MESH_OPT_LRU_CACHE_SIZE + 3);
+
+		unsigned int scan_cursor = 0;
+		int best_triangle = 0;
+
+		while (best_triangle >= 0)
+		{
+			emitted[best_triangle] = true;
+			unsigned int tri[3] = { indices[best_triangle * 3], indices[best_triangle * 3 + 1], indices[best_triangle * 3 + 2] };
+
+			// push the three vertices to the front of the cache
+			new_cache.assign(tri, tri + 3);
+			for (unsigned int v : cache)
+			{
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					new_cache.push_back(v);
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				output.push_back(tri[k]);
+				live_count[tri[k]]--;
+				// remove the triangle from the adjacency of the vertex
+				unsigned int begin = adjacency_offset[tri[k]];
+				unsigned int end = begin + live_count[tri[k]] + 1;
+				for (unsigned int a = begin; a < end; a++)
+				{
+					if (adjacency[a] == (unsigned int)best_triangle)
+					{
+						std::swap(adjacency[a], adjacency[end - 1]);
+						break;
+					}
+				}
+			}
+
+			// vertices that fell out of the cache lose their cache score
+			for (unsigned int i = MESH_OPT_LRU_CACHE_SIZE; i < new_cache.size(); i++)
+			{
+				unsigned int v = new_cache[i];
+				cache_position[v] = -1;
+				vertex_score[v] = forsyth_score(-1, live_count[v]);
+			}
+			if (new_cache.size() > MESH_OPT_LRU_CACHE_SIZE)
+				new_cache.resize(MESH_OPT_LRU_CACHE_SIZE);
+			cache.swap(new_cache);
+
+			// rescore the cached vertices and their live triangles, pick the best one
+			best_triangle = -1;
+			float best_score = -1.0f;
+			for (unsigned int i = 0; i < cache.size(); i++)
+			{
+				unsigned int v = cache[i];
+				cache_position[v] = (int)i;
+				vertex_score[v] = forsyth_score((int)i, live_count[v]);
+			}
+			for (unsigned int i = 0; i < cache.size(); i++)
+			{
+				unsigned int v = cache[i];
+				unsigned int begin = adjacency_offset[v];
+				for (unsigned int a = begin; a < begin + live_count[v]; a++)
+				{
+					unsigned int t = adjacency[a];
+					float score = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+					if (score > best_score)
+					{
+						best_score = score;
+						best_triangle = (int)t;
+					}
+				}
+			}
+
+			// nothing touches the cache, continue with the next triangle in input order
+			if (best_triangle < 0)
+			{
+				while (scan_cursor < numTriangles && emitted[scan_cursor])
+					scan_cursor++;
+				if (scan_cursor < numTriangles)
+					best_triangle = (int)scan_cursor;
+			}
+		}
+
+		indices.swap(output);
+	}
+
+	//Sander et al. "Fast triangle reordering for vertex locality and reduced overdraw"
+	//cut the cache optimised list into clusters and draw the outward facing ones first
+	template<typename VERTEX>
+	static void optimize_overdraw(const std::vector<VERTEX>& vertices, std::vector<unsigned int>& indices,
+		float threshold = MESH_OPT_OVERDRAW_THRESHOLD)
+	{
+		unsigned int numTriangles = (unsigned int)indices.size() / 3;
+		if (numTriangles < 2)
+			return;
+
+		unsigned int numVertices = (unsigned int)vertices.size();
+		float original_acmr = compute_acmr(indices, numVertices);
+
+		// cluster starts where every vertex of a triangle misses the cache (the natural restarts)
+		std::vector<unsigned int> cluster_start;
+		{
+			std::vector<unsigned int> cache_time(numVertices, 0);
+			unsigned int time = MESH_OPT_FIFO_CACHE_SIZE + 1;
+			for (unsigned int t = 0; t < numTriangles; t++)
+			{
+				int misses = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int index = indices[t * 3 + k];
+					if (time - cache_time[index] > MESH_OPT_FIFO_CACHE_SIZE)
+					{
+						cache_time[index] = time;
+						time++;
+						misses++;
+					}
+				}
+				if (t == 0 || misses == 3)
+					cluster_start.push_back(t);
+			}
+		}
+		if (cluster_start.size() < 2)
+			return;
+		cluster_start.push_back(numTriangles);
+
+		// mesh centroid
+		Vec3 mesh_center;
+		for (const VERTEX& v : vertices)
+		{
+			mesh_center += v.pos;
+		}
+		mesh_center /= (float)max(numVertices, 1u);
+
+		struct Cluster
+		{
+			unsigned int first;
+			unsigned int count;
+			float sort_key;
+		};
+		std::vector<Cluster> clusters;
+		clusters.reserve(cluster_start.size() - 1);
+
+		for (unsigned int c = 0; c + 1 < cluster_start.size(); c++)
+		{
+			Vec3 center;
+			Vec3 normal;
+			float area_sum = 0;
+			for (unsigned int t = cluster_start[c]; t < cluster_start[c + 1]; t++)
+			{
+				Vec3 p0 = vertices[indices[t * 3]].pos;
+				Vec3 p1 = vertices[indices[t * 3 + 1]].pos;
+				Vec3 p2 = vertices[indices[t * 3 + 2]].pos;
+				Vec3 n = (p1 - p0).Cross(p2 - p0);
+				float area = n.length();
+				center += (p0 + p1 + p2) * (area / 3.0f);
+				normal += n;
+				area_sum += area;
+			}
+			if (area_sum > 0)
+				center /= area_sum;
+			float normal_length = normal.length();
+			if (normal_length > 0)
+				normal /= normal_length;
+
+			Cluster cluster;
+			cluster.first = cluster_start[c];
+			cluster.count = cluster_start[c + 1] - cluster_start[c];
+			cluster.sort_key = (center - mesh_center).Dot(normal);
+			clusters.push_back(cluster);
+		}
+
+		// outward facing clusters first, they are the likely occluders
+		std::stable_sort(clusters.begin(), clusters.end(),
+			[](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+		std::vector<unsigned int> sorted;
+		sorted.reserve(indices.size());
+		for (const Cluster& cluster : clusters)
+		{
+			sorted.insert(sorted.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+		}
+
+		// keep the cache friendly order if reordering costs too many extra misses
+		if (compute_acmr(sorted, numVertices) <= original_acmr * threshold)
+			indices.swap(sorted);
+	}
+
+	//vertices in order of first use by the index buffer, unused vertices are dropped
+	template<typename VERTEX>
+	static void optimize_vertex_fetch(std::vector<VERTEX>& vertices, std::vector<unsigned int>& indices)
+	{
+		const unsigned int unused = 0xFFFFFFFF;
+		std::vector<unsigned int> remap(vertices.size(), unused);
+		std::vector<VERTEX> ordered;
+		ordered.reserve(vertices.size());
+
+		for (unsigned int& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = (unsigned int)ordered.size();
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(ordered);
+	}
+
+	//run every stage in order
+	template<typename VERTEX>
+	static MeshOptimizeReport optimize(std::vector<VERTEX>& vertices, std::vector<unsigned int>& indices)
+	{
+		MeshOptimizeReport report;
+		report.vertices_in = (unsigned int)vertices.size();
+		report.triangles = (unsigned int)indices.size() / 3;
+		report.acmr_input = compute_acmr(indices, (unsigned int)vertices.size());
+
+		weld_vertices(vertices, indices);
+		report.acmr_weld = compute_acmr(indices, (unsigned int)vertices.size());
+
+		// already well ordered meshes can come out slightly worse, only keep a real improvement
+		std::vector<unsigned int> cache_order = indices;
+		optimize_vertex_cache(cache_order, (unsigned int)vertices.size());
+		if (compute_acmr(cache_order, (unsigned int)vertices.size()) < report.acmr_weld)
+			indices.swap(cache_order);
+		report.acmr_vertex_cache = compute_acmr(indices, (unsigned int)vertices.size());
+
+		optimize_overdraw(vertices, indices);
+		report.acmr_overdraw = compute_acmr(indices, (unsigned int)vertices.size());
+
+		optimize_vertex_fetch(vertices, indices);
+		report.acmr_vertex_fetch = compute_acmr(indices, (unsigned int)vertices.size());
+
+		report.vertices_out = (unsigned int)vertices.size();
+		return report;
+	}
+
+private:
+	static float forsyth_score(int cachePosition, unsigned int liveTriangles)
+	{
+		// no triangle left, never pick again
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// the last triangle's vertices get a fixed score so we don't favour them over other cached ones
+			if (cachePosition < 3)
+			{
+				score = 0.75f;
+			}
+			else
+			{
+				const float scaler = 1.0f / (MESH_OPT_LRU_CACHE_SIZE - 3);
+				score = 1.0f - (cachePosition - 3) * scaler;
+				score = powf(score, 1.5f);
+			}
+		}
+		// boost vertices with few triangles left so we finish them off
+		score += 2.0f * powf((float)liveTriangles, -0.5f);
+		return score;
+	}
+};
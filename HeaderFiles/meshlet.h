@@ -0,0 +1,251 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include "vectors.h"
+#include "frustum.h"
+
+//Meshlets
+/*
+– a mesh cut into small clusters of triangles (<= 64 vertices, <= 124 triangles)
+– each meshlet keeps a local vertex list and 8-bit local triangle indices (mesh shader layout)
+– bounds per meshlet:
+	• bounding sphere, for frustum culling
+	• normal cone (axis + cutoff), for backface culling of the whole cluster
+– a cluster is fully backfacing when the view direction lies inside the cone:
+	dot(center - camera, axis) >= cutoff * |center - camera| + radius
+– cutoff = sin(half angle of the cone), 1 means the normals spread too wide to ever cull
+– cone culling is only valid for single-sided geometry, the PSOs here draw with CULL_NONE
+	so it is opt-in per call
+*/
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	unsigned int vertexOffset;		// into MeshletData::vertices
+	unsigned int vertexCount;
+	unsigned int triangleOffset;	// into MeshletData::triangles, 3 bytes per triangle
+	unsigned int triangleCount;
+
+	Vec3 center;
+	float radius;
+	Vec3 cone_axis;
+	float cone_cutoff;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	// meshlet local vertex -> mesh vertex
+	std::vector<unsigned int> vertices;
+	// meshlet local triangle indices
+	std::vector<unsigned char> triangles;
+};
+
+struct MeshletCullStats
+{
+	unsigned int total = 0;
+	unsigned int frustum_culled = 0;
+	unsigned int cone_culled = 0;
+	unsigned int visible = 0;
+
+	void reset()
+	{
+		total = frustum_culled = cone_culled = visible = 0;
+	}
+};
+
+class MeshletBuilder
+{
+public:
+	//greedy build in index order, run it after the vertex cache optimisation so neighbouring triangles stay together
+	template<typename VERTEX>
+	static void build(const std::vector<VERTEX>& vertices, const std::vector<unsigned int>& indices, MeshletData& out,
+		unsigned int maxVertices = MESHLET_MAX_VERTICES, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+	{
+		const unsigned int unused = 0xFFFFFFFF;
+		std::vector<unsigned int> local(vertices.size(), unused);
+		std::vector<unsigned int> stamp(vertices.size(), unused);
+
+		out.meshlets.clear();
+		out.vertices.clear();
+		out.triangles.clear();
+
+		Meshlet meshlet = {};
+		unsigned int meshletId = 0;
+
+		for (unsigned int t = 0; t + 2 < indices.size(); t += 3)
+		{
+			unsigned int added = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t + k];
+				bool seen = stamp[v] == meshletId;
+				for (int j = 0; j < k; j++)
+				{
+					if (indices[t + j] == v)
+						seen = true;
+				}
+				if (!seen)
+					added++;
+			}
+
+			if (meshlet.vertexCount + added > maxVertices || meshlet.triangleCount + 1 > maxTriangles)
+			{
+				finish(vertices, out, meshlet);
+				meshletId++;
+				meshlet = {};
+				meshlet.vertexOffset = (unsigned int)out.vertices.size();
+				meshlet.triangleOffset = (unsigned int)out.triangles.size();
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t + k];
+				if (stamp[v] != meshletId)
+				{
+					stamp[v] = meshletId;
+					local[v] = meshlet.vertexCount++;
+					out.vertices.push_back(v);
+				}
+				out.triangles.push_back((unsigned char)local[v]);
+			}
+			meshlet.triangleCount++;
+		}
+		if (meshlet.triangleCount > 0)
+			finish(vertices, out, meshlet);
+	}
+
+	//expand the meshlets back into a plain 32-bit triangle list, meshlet after meshlet
+	static void to_index_list(const MeshletData& data, std::vector<unsigned int>& indices)
+	{
+		indices.clear();
+		indices.reserve(data.triangles.size());
+		for (const Meshlet& m : data.meshlets)
+		{
+			for (unsigned int i = 0; i < m.triangleCount * 3; i++)
+			{
+				indices.push_back(data.vertices[m.vertexOffset + data.triangles[m.triangleOffset + i]]);
+			}
+		}
+	}
+
+private:
+	template<typename VERTEX>
+	static void finish(const std::vector<VERTEX>& vertices, MeshletData& out, Meshlet& meshlet)
+	{
+		compute_bounds(vertices, out, meshlet);
+		out.meshlets.push_back(meshlet);
+	}
+
+	template<typename VERTEX>
+	static void compute_bounds(const std::vector<VERTEX>& vertices, const MeshletData& out, Meshlet& meshlet)
+	{
+		// sphere around the box centre
+		Vec3 box_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vec3 box_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+		{
+			const Vec3& p = vertices[out.vertices[meshlet.vertexOffset + i]].pos;
+			box_min = Min(box_min, p);
+			box_max = Max(box_max, p);
+		}
+		meshlet.center = (box_min + box_max) * 0.5f;
+		float radius_sq = 0;
+		for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+		{
+			const Vec3& p = vertices[out.vertices[meshlet.vertexOffset + i]].pos;
+			radius_sq = max(radius_sq, (p - meshlet.center).length_Square());
+		}
+		meshlet.radius = sqrtf(radius_sq);
+
+		// normal cone from the face normals (front face normal = (p1 - p0) x (p2 - p0))
+		std::vector<Vec3> normals;
+		normals.reserve(meshlet.triangleCount);
+		Vec3 axis(0, 0, 0);
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			const unsigned char* tri = &out.triangles[meshlet.triangleOffset + t * 3];
+			const Vec3& p0 = vertices[out.vertices[meshlet.vertexOffset + tri[0]]].pos;
+			const Vec3& p1 = vertices[out.vertices[meshlet.vertexOffset + tri[1]]].pos;
+			const Vec3& p2 = vertices[out.vertices[meshlet.vertexOffset + tri[2]]].pos;
+			Vec3 n = Cross(p1 - p0, p2 - p0);
+			float len = n.length();
+			// degenerate triangles never face anywhere
+			if (len <= 1e-12f)
+				continue;
+			n = n / len;
+			normals.push_back(n);
+			axis += n;
+		}
+
+		meshlet.cone_axis = Vec3(0, 0, 0);
+		meshlet.cone_cutoff = 1.0f;
+		float axis_len = axis.length();
+		if (normals.empty() || axis_len <= 1e-6f)
+			return;
+		axis = axis / axis_len;
+
+		float min_dot = 1.0f;
+		for (const Vec3& n : normals)
+		{
+			min_dot = min(min_dot, Dot(n, axis));
+		}
+		meshlet.cone_axis = axis;
+		// normals wider than a hemisphere, some triangle always faces the camera
+		if (min_dot <= 0)
+			return;
+		meshlet.cone_cutoff = sqrtf(1.0f - SQ(min_dot));
+	}
+};
+
+class MeshletCuller
+{
+public:
+	//frustum (and optionally normal cone) test of every meshlet, world is the object's world matrix
+	//camera_pos and frustum are in world space, visible gets the indices of the surviving meshlets
+	static void cull(const MeshletData& data, const Matrix& world, const Frustum& frustum, const Vec3& camera_pos,
+		bool cone_culling, std::vector<unsigned int>& visible, MeshletCullStats* stats = nullptr)
+	{
+		visible.clear();
+
+		// a sphere stays a sphere under the world matrix, scale the radius by the largest axis
+		float scale = sqrtf(max(max(SQ(world.m[0]) + SQ(world.m[4]) + SQ(world.m[8]),
+			SQ(world.m[1]) + SQ(world.m[5]) + SQ(world.m[9])),
+			SQ(world.m[2]) + SQ(world.m[6]) + SQ(world.m[10])));
+
+		for (unsigned int i = 0; i < data.meshlets.size(); i++)
+		{
+			const Meshlet& m = data.meshlets[i];
+			Vec3 center = world.mulPoint(m.center);
+			float radius = m.radius * scale;
+
+			if (!frustum.sphere_visible(center, radius))
+			{
+				if (stats) stats->frustum_culled++;
+				continue;
+			}
+
+			if (cone_culling && m.cone_cutoff < 1.0f)
+			{
+				Vec3 axis = world.mulVec(m.cone_axis).Normalize();
+				Vec3 view = center - camera_pos;
+				if (Dot(view, axis) >= m.cone_cutoff * view.length() + radius)
+				{
+					if (stats) stats->cone_culled++;
+					continue;
+				}
+			}
+
+			visible.push_back(i);
+		}
+
+		if (stats)
+		{
+			stats->total += (unsigned int)data.meshlets.size();
+			stats->visible += (unsigned int)visible.size();
+		}
+	}
+};
@@ -10,6 +10,13 @@
 #include "textureloader.h"
 #include "AABB.h"
 #include "loadfiles.h"
+#include "mesh_optimizer.h"
+#include "instance_sort.h"
+#include "render_queue.h"
+#include "animation_jobs.h"
+#include "skinning.h"
+#include "root_motion.h"
+#include "model_registry.h"
 
 static STATIC_VERTEX addVertex(Vec3 p, Vec3 n, float tu, float tv)
 {
@@ -313,7 +320,8 @@ class Object
 {
 public:
 	std::string name;
-	std::vector<Mesh*> meshes;
+	// meshes + materials, shared with every Object that loads the same file
+	ModelData* data = nullptr;
 	Shader_Manager* shader_manager;
 	PSOManager* psos;
 
@@ -323,51 +331,29 @@ public:
 	//std::string ps_name = "PS_Trans";
 	std::string pso_name = "StaticModel_Trans_POM_PSO";
 
-	//std::vector<std::vector<std::string>> textureFilenames;
-	std::vector<std::string> textureFilenames;
-	//std::vector<std::string> textureFilenames2;
 	Texture_Manager* textures;
 	//Texture_Manager2* textures2;
 
 	HitBox hitbox;
 
-	void init_meshes(Core* core, std::string filename)
+	// draws go to the queue when set
+	RenderQueue* render_queue = nullptr;
+	RenderBinding binding;
+
+	Object() {}
+	// data is counted per object
+	Object(const Object&) = delete;
+	Object& operator=(const Object&) = delete;
+
+	~Object()
 	{
-		GEMLoader::GEMModelLoader loader;
-		std::vector<GEMLoader::GEMMesh> gemmeshes;
-		GEMLoader::GEMAnimation gemanimation;
-		std::string root = "Models/" + filename + ".gem";
-		//std::string gem_root = root + filename + ".gem";
-		loader.load(root, gemmeshes, gemanimation);
-		for (int i = 0; i < gemmeshes.size(); i++) {
-			Mesh* mesh = new Mesh();
-			std::vector<STATIC_VERTEX> vertices;
-			for (int j = 0; j < gemmeshes[i].verticesStatic.size(); j++) {
-				STATIC_VERTEX v;
-				memcpy(&v, &gemmeshes[i].verticesStatic[j], sizeof(STATIC_VERTEX));
-				vertices.push_back(v);
-				hitbox.local_aabb.expand(v.pos);
-			}
+		ModelRegistry::get().release(data);
+	}
 
-			//get all three textures file roots,
-			std::string tex_root_alb = gemmeshes[i].material.find("albedo").getValue();
-			std::string tex_root_nh = gemmeshes[i].material.find("nh").getValue();
-			std::string tex_root_rmax = gemmeshes[i].material.find("rmax").getValue();
-			//textureFilenames[i].push_back(tex_root_alb);
-
-			//use the albedo texture name as the matarial name
-			textureFilenames.push_back(tex_root_alb);
-			std::vector<std::string> filenames;
-			filenames.push_back(tex_root_alb);
-			filenames.push_back(tex_root_nh);
-			filenames.push_back(tex_root_rmax);
-			// load 3 textures in the same matrial.
-			textures->load(core, tex_root_alb, filenames);
-
-			mesh->init(core, vertices, gemmeshes[i].indices);
-			meshes.push_back(mesh);
-		}
-		hitbox.local_aabb.update_cache();
+	void init_meshes(Core* core, std::string filename)
+	{
+		data = ModelRegistry::get().acquire(core, textures, filename, false);
+		hitbox.local_aabb = data->bounds;
 	}
 
 	void init(Core* core, Shader_Manager* _shader_manager, PSOManager* _psos, Texture_Manager* _textures, std::string filename)
@@ -413,16 +399,41 @@ public:
 		}
 	}
 
+	//call after init
+	void set_render_queue(Core* core, RenderQueue* queue)
+	{
+		render_queue = queue;
+		binding.resolve(core, psos, shader_manager, textures, pso_name, vs_name, ps_name, data->textureFilenames);
+	}
+
+	void submit(Matrix& planeWorld, Matrix& vp)
+	{
+		D3D12_GPU_VIRTUAL_ADDRESS vs_cb, ps_cb;
+		binding.capture(vs_cb, ps_cb);
+		float depth = RenderQueue::view_depth(vp, planeWorld);
+		// a hot reload (ModelRegistry::reload) can bring more meshes than the binding has materials
+		for (int i = 0; i < data->meshes.size() && i < binding.material_ids.size(); i++)
+		{
+			unsigned long long key = RenderQueue::make_key(RENDER_PASS_OPAQUE, binding.pso_id, binding.material_ids[i], depth);
+			render_queue->submit(key, binding, i, 3, vs_cb, ps_cb, data->meshes[i]);
+		}
+	}
+
 	void draw(Core* core, Matrix planeWorld, Matrix vp) {
 		update(planeWorld, vp);
+		if (render_queue)
+		{
+			submit(planeWorld, vp);
+			return;
+		}
 		core->beginRenderPass();
 		apply(core);
 		psos->bind(core, pso_name);
-		for (int i = 0; i < meshes.size(); i++)
+		for (int i = 0; i < data->meshes.size(); i++)
 		{
 			//shader_manager->updateTexturePS(core, "PixelShaderWithTransparence", "tex", textures->find(textureFilenames[i]));
-			textures->updateTexturePS(core, textureFilenames[i]);
-			meshes[i]->draw(core);
+			textures->updateTexturePS(core, data->textureFilenames[i]);
+			data->meshes[i]->draw(core);
 		}
 	}
 };
@@ -436,6 +447,13 @@ public:
 	PSOManager* psos;
 
 	std::vector<INSTANCE> instances_matix;
+	// alpha foliage: cull + sort the instances far to near every frame
+	bool depth_sort = false;
+	InstanceDepthSorter sorter;
+
+	// draws go to the queue when set
+	RenderQueue* render_queue = nullptr;
+	RenderBinding binding;
 
 	//std::string vs_name = "VS_Static_Ins";
 	std::string vs_name = "VS_Static_Ins_VAni";
@@ -450,48 +468,30 @@ public:
 
 	HitBox hitbox;
 
+	// the .gem's meshes + materials, shared through the registry (nullptr for the ground rectangle)
+	ModelData* data = nullptr;
+	// data->generation the meshes were made from
+	unsigned int data_generation = 0;
+
+	Object_Instance() {}
+	// data is counted per object
+	Object_Instance(const Object_Instance&) = delete;
+	Object_Instance& operator=(const Object_Instance&) = delete;
+
+	~Object_Instance()
+	{
+		ModelRegistry::get().release(data);
+	}
 
 	void init_meshes(Core* core, std::string filename)
 	{
 		//create_matixes();
 		//save_instance_matrices(FILE_NAME_FLOWER_MATRIX, instances_matix);
 		//load_instance_matrices(FILE_NAME_FLOWER_MATRIX, instances_matix);
-		
-		GEMLoader::GEMModelLoader loader;
-		std::vector<GEMLoader::GEMMesh> gemmeshes;
-		GEMLoader::GEMAnimation gemanimation;
-		std::string root = "Models/" + filename + ".gem";
-		//std::string gem_root = root + filename + ".gem";
-		loader.load(root, gemmeshes, gemanimation);
-		for (int i = 0; i < gemmeshes.size(); i++) {
-			Mesh_Istancing* mesh = new Mesh_Istancing();
-			std::vector<STATIC_VERTEX> vertices;
-			for (int j = 0; j < gemmeshes[i].verticesStatic.size(); j++) {
-				STATIC_VERTEX v;
-				memcpy(&v, &gemmeshes[i].verticesStatic[j], sizeof(STATIC_VERTEX));
-				vertices.push_back(v);
-				hitbox.local_aabb.expand(v.pos);
-			}
 
-			//get all three textures file roots,
-			std::string tex_root_alb = gemmeshes[i].material.find("albedo").getValue();
-			std::string tex_root_nh = gemmeshes[i].material.find("nh").getValue();
-			std::string tex_root_rmax = gemmeshes[i].material.find("rmax").getValue();
-			//textureFilenames[i].push_back(tex_root_alb);
-
-			//use the albedo texture name as the matarial name
-			textureFilenames.push_back(tex_root_alb);
-			std::vector<std::string> filenames;
-			filenames.push_back(tex_root_alb);
-			filenames.push_back(tex_root_nh);
-			filenames.push_back(tex_root_rmax);
-			// load 3 textures in the same matrial.
-			textures->load(core, tex_root_alb, filenames);
-			
-			mesh->init(core, vertices, gemmeshes[i].indices, instances_matix, instances_matix.size() + 10);
-			meshes.push_back(mesh);
-		}
-		hitbox.local_aabb.update_cache();
+		// vertex + index buffers and textures are the registry's, every batch of the .gem draws the same ones
+		data = ModelRegistry::get().acquire(core, textures, filename, false);
+		init_instancing(core);
 	}
 
 	//ground retangle init
@@ -592,6 +592,57 @@ public:
 			hitbox.init(core, hitbox.local_aabb);
 	}
 
+	//call after init, the instance data moves to a per frame upload buffer
+	void enable_depth_sort(Core* core)
+	{
+		depth_sort = true;
+		sorter.init_bounds(instances_matix, hitbox.local_aabb.get_center(), hitbox.local_aabb.get_halfSize().length());
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			meshes[i]->init_dynamic_instance_buffer(core);
+		}
+	}
+
+	//hot reload: instances is swapped in, only the instance buffers are written again
+	void set_instances(Core* core, std::vector<INSTANCE>& instances)
+	{
+		instances_matix.swap(instances);
+		core->flushGraphicsQueue();
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			meshes[i]->set_instances(core, instances_matix);
+		}
+		if (depth_sort)
+			sorter.init_bounds(instances_matix, hitbox.local_aabb.get_center(), hitbox.local_aabb.get_halfSize().length());
+	}
+
+	//hot reload of Models/<name>.gem: new meshes, textures and bounds for the same instances, false keeps the old ones
+	bool reload_meshes(Core* core)
+	{
+		if (!data)
+			return false;
+		// the first batch of the .gem has the registry cook + upload it again, the others only take the new meshes
+		// a file that is still being written fails here
+		if (data->generation == data_generation && !ModelRegistry::get().reload(data))
+			return false;
+		core->flushGraphicsQueue();
+		free_instancing();
+		init_instancing(core);
+		if (depth_sort)
+			enable_depth_sort(core);
+		if (render_queue)
+			set_render_queue(core, render_queue);
+		return true;
+	}
+
+	//the GPU has to be done with the meshes first (Core::flushGraphicsQueue)
+	void free()
+	{
+		free_instancing();
+		ModelRegistry::get().release(data);
+		data = nullptr;
+	}
+
 	void update( Matrix vp) {
 		//shader_manager->update(vs_name, "staticMeshBuffer", "W", &planeWorld);
 		shader_manager->update(vs_name, "staticMeshBuffer", "VP", &vp);
@@ -618,9 +669,45 @@ public:
 		}
 	}
 
+	//call after init
+	void set_render_queue(Core* core, RenderQueue* queue)
+	{
+		render_queue = queue;
+		binding.resolve(core, psos, shader_manager, textures, pso_name, vs_name, ps_name, textureFilenames);
+	}
+
+	//the sorted foliage goes in the alpha pass, its instances are already in order
+	void submit()
+	{
+		D3D12_GPU_VIRTUAL_ADDRESS vs_cb, ps_cb;
+		binding.capture(vs_cb, ps_cb);
+		Render_Pass pass = depth_sort ? RENDER_PASS_ALPHA : RENDER_PASS_OPAQUE;
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			unsigned long long key = RenderQueue::make_key(pass, binding.pso_id, binding.material_ids[i], 0.0f);
+			render_queue->submit(key, binding, i, 3, vs_cb, ps_cb, meshes[i]);
+		}
+	}
+
 	void draw(Core* core, Matrix& vp)
 	{
+		if (depth_sort)
+		{
+			sorter.sort(instances_matix, vp);
+			if (sorter.sorted.empty())
+				return;
+			for (int i = 0; i < meshes.size(); i++)
+			{
+				meshes[i]->update_instance_matix_dynamic(core, sorter.sorted.data(), sorter.sorted.size());
+			}
+		}
+
 		update(vp);
+		if (render_queue)
+		{
+			submit();
+			return;
+		}
 		core->beginRenderPass();
 		apply(core);
 		psos->bind(core, pso_name);
@@ -631,15 +718,46 @@ public:
 			meshes[i]->draw(core);
 		}
 	}
+
+private:
+	//one instanced mesh per shared mesh, bounds + material names from data
+	void init_instancing(Core* core)
+	{
+		data_generation = data->generation;
+		hitbox.local_aabb = data->bounds;
+		textureFilenames = data->textureFilenames;
+		for (Mesh* geometry : data->meshes)
+		{
+			Mesh_Istancing* mesh = new Mesh_Istancing();
+			mesh->init(core, geometry, instances_matix, instances_matix.size() + 10);
+			meshes.push_back(mesh);
+		}
+	}
+
+	//the instance buffers (+ the ground rectangle's own vertex / index buffers)
+	void free_instancing()
+	{
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			meshes[i]->free();
+			delete meshes[i];
+		}
+		meshes.clear();
+	}
 };
 
 class Object_Animation
 {
 public:
 	std::string name;
-	std::vector<Mesh*> meshes;
-	Animation animation;
+	// meshes, skeleton + clips, root motion, skinning subset, baked palettes: shared with every character on the same file
+	ModelData* data = nullptr;
 	AnimationInstance animation_instance;
+	// update rate + bone count by distance, used when the animation goes through AnimationJobs
+	AnimationLOD lod;
+	// skins the model's vertex subset (step + bone outlines) on the CPU for the hitbox, the bounds are this character's
+	CpuSkinning skinning;
+	bool skinned_bounds = false;
 
 	Shader_Manager* shader_manager;
 	PSOManager* psos;
@@ -648,84 +766,32 @@ public:
 	std::string ps_name = "PS";
 	std::string pso_name = "AnimationModel_PSO";
 
-	std::vector<std::string> textureFilenames;
 	Texture_Manager* textures;
 
 	HitBox hitbox;
 
-	void init_meshes(Core* core, std::string filename)
-	{
-		GEMLoader::GEMModelLoader loader;
-		std::vector<GEMLoader::GEMMesh> gemmeshes;
-		GEMLoader::GEMAnimation gemanimation;
-		std::string root = "Models/" + filename + ".gem";
-		//std::string gem_root = root + filename + ".gem";
-		loader.load(root, gemmeshes, gemanimation);
-		for (int i = 0; i < gemmeshes.size(); i++) {
-			Mesh* mesh = new Mesh();
-			std::vector<ANIMATED_VERTEX> vertices;
-			for (int j = 0; j < gemmeshes[i].verticesAnimated.size(); j++) {
-				ANIMATED_VERTEX v;
-				memcpy(&v, &gemmeshes[i].verticesAnimated[j], sizeof(ANIMATED_VERTEX));
-				vertices.push_back(v);
-				hitbox.local_aabb.expand(v.pos);
-			}
+	// draws go to the queue when set
+	RenderQueue* render_queue = nullptr;
+	RenderBinding binding;
 
-			std::string tex_root_alb = gemmeshes[i].material.find("albedo").getValue();
-			std::string tex_root_nh = gemmeshes[i].material.find("nh").getValue();
-			std::string tex_root_rmax = gemmeshes[i].material.find("rmax").getValue();
-			//textureFilenames[i].push_back(tex_root_alb);
+	Object_Animation() {}
+	// data is counted per object
+	Object_Animation(const Object_Animation&) = delete;
+	Object_Animation& operator=(const Object_Animation&) = delete;
 
-			//use the albedo texture name as the matarial name
-			textureFilenames.push_back(tex_root_alb);
-			std::vector<std::string> filenames;
-			filenames.push_back(tex_root_alb);
-			filenames.push_back(tex_root_nh);
-			filenames.push_back(tex_root_rmax);
-			textures->load(core, tex_root_alb, filenames);
-
-			mesh->init_animation(core, vertices, gemmeshes[i].indices);
-			meshes.push_back(mesh);
-		}
-		hitbox.local_aabb.update_cache();
-
-		//Bones
-		memcpy(&animation.skeleton.globalInverse, &gemanimation.globalInverse, 16 * sizeof(float));
-		for (int i = 0; i < gemanimation.bones.size(); i++)
-		{
-			Bone bone;
-			bone.name = gemanimation.bones[i].name;
-			memcpy(&bone.offset, &gemanimation.bones[i].offset, 16 * sizeof(float));
-			bone.parentIndex = gemanimation.bones[i].parentIndex;
-			animation.skeleton.bones.push_back(bone);
-		}
+	~Object_Animation()
+	{
+		ModelRegistry::get().release(data);
+	}
 
-		for (int i = 0; i < gemanimation.animations.size(); i++)
-		{
-			std::string name = gemanimation.animations[i].name;
-			AnimationSequence aseq;
-			aseq.ticksPerSecond = gemanimation.animations[i].ticksPerSecond;
-			for (int n = 0; n < gemanimation.animations[i].frames.size(); n++)
-			{
-				AnimationFrame frame;
-				for (int index = 0; index < gemanimation.animations[i].frames[n].positions.size(); index++)
-				{
-					Vec3 p;
-					Quaternion q;
-					Vec3 s;
-					memcpy(&p, &gemanimation.animations[i].frames[n].positions[index], sizeof(Vec3));
-					frame.positions.push_back(p);
-					memcpy(&q, &gemanimation.animations[i].frames[n].rotations[index], sizeof(Quaternion));
-					frame.rotations.push_back(q);
-					memcpy(&s, &gemanimation.animations[i].frames[n].scales[index], sizeof(Vec3));
-					frame.scales.push_back(s);
-				}
-				aseq.frames.push_back(frame);
-			}
-			animation.animations.insert({ name, aseq });
-		}
+	void init_meshes(Core* core, std::string filename)
+	{
+		data = ModelRegistry::get().acquire(core, textures, filename, true);
+		hitbox.local_aabb = data->bounds;
+		skinning.share(data->skinning);
 
-		animation_instance.init(&animation, 0);
+		animation_instance.init(&data->animation, 0);
+		lod.init(&data->animation);
 	}
 	void init(Core* core, Shader_Manager* _shader_manager, PSOManager* _psos, Texture_Manager* _textures, std::string filename)
 	{
@@ -753,20 +819,137 @@ public:
 		shader_manager->update(vs_name, "animatedMeshBuffer", "W", &w);
 	}
 
-	void update_animation_instance(AnimationInstance* ani_in, float dt, std::string move)
+	//clip changes blend over this many seconds instead of snapping, 0 = snap
+	void set_cross_fade(float seconds)
+	{
+		animation_instance.crossFadeTime = seconds;
+	}
+
+	//bone name -> index for animation_instance.findWorldMatrix, resolve once and keep it
+	int find_bone(const std::string& bone)
+	{
+		return data->animation.skeleton.findBone(bone);
+	}
+
+	//crowds: these clips are sampled once at rate and looked up from then on
+	void bake_palettes(const std::vector<std::string>& clip_names, float rate = BAKED_PALETTE_RATE, bool lerp = true)
+	{
+		std::vector<ClipHandle> clips;
+		for (const std::string& clip_name : clip_names)
+			clips.push_back(data->animation.findClip(clip_name));
+		// baked once per model, every character on it shares the palettes
+		ModelRegistry::get().bake(data, clips, rate);
+		animation_instance.baked = &data->baked_palettes;
+		animation_instance.bakedLerp = lerp;
+	}
+
+	//clip name -> handle, resolve once and keep it
+	ClipHandle find_clip(const std::string& move)
+	{
+		return data->animation.findClip(move);
+	}
+
+	//the model's clips load on first use (ModelRegistry), call before the clip is sampled or its root motion read
+	void use_clip(ClipHandle move)
+	{
+		ModelRegistry::get().use_clip(data, move);
+	}
+
+	//playback rate that makes the clip cover speed units per second, 1 for clips that do not travel
+	float root_motion_rate(ClipHandle move, float speed)
 	{
+		use_clip(move);
+		return data->root_motion.travels(move) ? speed / data->root_motion.speed(move) : 1.0f;
+	}
+
+	//how far the clip's feet carry the character over the next ani_dt of playback, fallback for clips that do not travel
+	float root_motion_distance(ClipHandle move, float ani_dt, float fallback)
+	{
+		use_clip(move);
+		if (!data->root_motion.travels(move))
+			return fallback;
+		float t0 = animation_instance.currentClip == move ? animation_instance.t : 0.0f;
+		return data->root_motion.distance(move, t0, ani_dt);
+	}
+
+	//hitbox.hit_aabb() follows the animated mesh instead of the bind pose, local_aabb stays the collision box
+	void enable_skinned_bounds(bool enable = true)
+	{
+		skinned_bounds = enable;
+		if (!enable)
+			hitbox.skinned = false;
+	}
+
+	//skinned bounds of the current palette -> hitbox.skinned_aabb, before hitbox.update_from_world
+	void refit_hitbox()
+	{
+		if (!skinned_bounds || skinning.size() == 0)
+			return;
+		hitbox.skinned_aabb = AABB(skinning.bounds_min, skinning.bounds_max);
+		hitbox.skinned_aabb.update_cache();
+		hitbox.skinned = true;
+	}
+
+	//the clip, the one fading out and every layer's
+	void use_clips(AnimationInstance* ani_in, ClipHandle move)
+	{
+		use_clip(move);
+		use_clip(ani_in->fadingClip());
+		for (const AnimationLayer& layer : ani_in->layers)
+			use_clip(layer.clip);
+	}
+
+	//AnimationInstance::addLayer, with the clip loaded first (its frame 0 is the additive reference)
+	int add_layer(ClipHandle clip, Blend_Mode mode, float weight, const BoneMask* mask = nullptr)
+	{
+		use_clip(clip);
+		return animation_instance.addLayer(clip, mode, weight, mask);
+	}
+
+	void update_animation_instance(AnimationInstance* ani_in, float dt, ClipHandle move)
+	{
+		use_clips(ani_in, move);
 		ani_in->update(move, dt);
 		if (ani_in->animationFinished() == true)
 		{
 			ani_in->resetAnimationTime();
 		}
 	}
-	void update(Matrix& planeWorld, Matrix& vp, float ani_dt, std::string move) {
+	void update_animation_instance(AnimationInstance* ani_in, float dt, const std::string& move)
+	{
+		update_animation_instance(ani_in, dt, data->animation.findClip(move));
+	}
+	void update(Matrix& planeWorld, Matrix& vp, float ani_dt, const std::string& move) {
+		update(planeWorld, vp, ani_dt, data->animation.findClip(move));
+	}
+	void update(Matrix& planeWorld, Matrix& vp, float ani_dt, ClipHandle move) {
 		update_animation_instance(&animation_instance, ani_dt, move);
+		upload(planeWorld, vp);
+		//update_hitbox(planeWorld);
+	}
+
+	//evaluated later by AnimationJobs::run, together with every other character
+	void queue_animation(AnimationJobs* jobs, float ani_dt, ClipHandle move)
+	{
+		// the jobs only sample, loading happens here
+		use_clips(&animation_instance, move);
+		jobs->add(&animation_instance, move, ani_dt, &lod, skinned_bounds ? &skinning : nullptr);
+	}
+
+	//LOD from the camera distance + frustum, call before queue_animation
+	void select_lod(Matrix& planeWorld, const Vec3& camera_position, const Frustum& frustum)
+	{
+		Vec3 center = planeWorld.mulPoint((hitbox.local_aabb.m_min + hitbox.local_aabb.m_max) * 0.5f);
+		Vec3 corner = planeWorld.mulPoint(hitbox.local_aabb.m_max);
+		lod.select(center, (corner - center).length(), camera_position, frustum);
+	}
+
+	void upload(Matrix& planeWorld, Matrix& vp)
+	{
 		shader_manager->update(vs_name, "animatedMeshBuffer", "W", &planeWorld);
 		shader_manager->update(vs_name, "animatedMeshBuffer", "VP", &vp);
-		shader_manager->update(vs_name, "animatedMeshBuffer", "bones", animation_instance.matrices);
-		//update_hitbox(planeWorld);
+		// only the skeleton's bones, not the whole 256 array
+		shader_manager->update(vs_name, "animatedMeshBuffer", "bones", animation_instance.matrices, animation_instance.paletteBytes());
 	}
 
 	void apply(Core* core)
@@ -787,18 +970,57 @@ public:
 		}
 	}
 
-	void draw(Core* core, Matrix& planeWorld, Matrix& vp, float dt, std::string move) 
+	//call after init
+	void set_render_queue(Core* core, RenderQueue* queue)
+	{
+		render_queue = queue;
+		binding.resolve(core, psos, shader_manager, textures, pso_name, vs_name, ps_name, data->textureFilenames);
+	}
+
+	void submit(Matrix& planeWorld, Matrix& vp)
+	{
+		D3D12_GPU_VIRTUAL_ADDRESS vs_cb, ps_cb;
+		binding.capture(vs_cb, ps_cb);
+		float depth = RenderQueue::view_depth(vp, planeWorld);
+		for (int i = 0; i < data->meshes.size(); i++)
+		{
+			unsigned long long key = RenderQueue::make_key(RENDER_PASS_OPAQUE, binding.pso_id, binding.material_ids[i], depth);
+			render_queue->submit(key, binding, i, 0, vs_cb, ps_cb, data->meshes[i]);
+		}
+	}
+
+	void draw(Core* core, Matrix& planeWorld, Matrix& vp, float dt, const std::string& move)
+	{
+		draw(core, planeWorld, vp, dt, data->animation.findClip(move));
+	}
+
+	void draw(Core* core, Matrix& planeWorld, Matrix& vp, float dt, ClipHandle move)
+	{
+		update_animation_instance(&animation_instance, dt, move);
+		if (skinned_bounds)
+			skinning.update_bounds(animation_instance.matrices, (unsigned int)data->animation.bonesSize());
+		draw_animated(core, planeWorld, vp);
+	}
+
+	//draw with the palette as it is, after queue_animation + AnimationJobs::run
+	void draw_animated(Core* core, Matrix& planeWorld, Matrix& vp)
 	{
-		update(planeWorld, vp, dt, move);
+		refit_hitbox();
+		upload(planeWorld, vp);
+		if (render_queue)
+		{
+			submit(planeWorld, vp);
+			return;
+		}
 		core->beginRenderPass();
 		apply(core);
 		psos->bind(core, pso_name);
 
-		for (int i = 0; i < meshes.size(); i++)
+		for (int i = 0; i < data->meshes.size(); i++)
 		{
 			//shader_manager->updateTexturePS(core, ps_name, "tex", textures->find(textureFilenames[i]));
-			textures->updateTexturePS(core, textureFilenames[i]);
-			meshes[i]->draw(core);
+			textures->updateTexturePS(core, data->textureFilenames[i]);
+			data->meshes[i]->draw(core);
 		}
 	}
 };
\ No newline at end of file
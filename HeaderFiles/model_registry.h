@@ -0,0 +1,336 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include "core.h"
+#include "mesh.h"
+#include "textureloader.h"
+#include "AABB.h"
+#include "animation.h"
+#include "skinning.h"
+#include "root_motion.h"
+#include "gem_cooked.h"
+#include "loadfiles.h"
+
+//Shared model data
+/*
+– one ModelData per .gem, loaded by the first acquire() and shared by every Object / Object_Animation that names the file
+– read only once loaded: GPU meshes, material names, bind pose bounds, skeleton + clips, root motion, the skinning subset, baked palettes
+– the objects keep only what is per entity: AnimationInstance, LOD, skinned bounds, hitbox, world matrix
+– Object_Instance batches draw the same meshes, each with its own instance buffer, two batches of one .gem upload it once
+– acquire() / release() count the users, the last release waits for the GPU and frees the meshes
+– one registry for the program, ModelRegistry::get(), a static like the layouts in VertexLayoutCache
+– lazy clips: an animated model keeps its .gemc mapped and only reads the clip directory (names, lengths) at load
+	• use_clip() copies a clip's tracks + keyframes in on its first use, and extracts its root motion then
+	• with clip_evict_age set, update() drops clips nobody used for that long, the next use reads them again
+	• clips are only loaded / dropped on the main thread, the animation jobs only sample clips used this frame
+– reload() (hot reload, static models) replaces the meshes, textures and bounds in place and moves generation on
+– .gemc files the AssetLoader opened ahead are handed over by add_opened(), the load takes them instead of hashing the .gem again
+*/
+
+// seconds of the registry clock, a clip evicted while cross-fading out would be sampled empty
+#define MODEL_CLIP_MIN_EVICT_AGE 1.0f
+
+struct ModelData
+{
+	std::string name;
+	std::string path;
+	bool animated = false;
+	std::vector<Mesh*> meshes;
+	// albedo file per mesh, also its material name
+	std::vector<std::string> textureFilenames;
+	AABB bounds;
+	// animated models only
+	Animation animation;
+	RootMotion root_motion;
+	CpuSkinning skinning;
+	BakedPalettes baked_palettes;
+	// lazy clips: the mapped .gemc, handle -> clip in it, registry time of the last use (< 0 = not loaded)
+	GEMCookedModel cooked;
+	std::vector<unsigned int> clip_index;
+	std::vector<float> clip_used;
+	unsigned int users = 0;
+	// reload() count, users that copied the buffer views rebuild when it moved on
+	unsigned int generation = 0;
+};
+
+class ModelRegistry
+{
+public:
+	// .gem files read vs objects that asked for one
+	unsigned int loads = 0;
+	unsigned int acquires = 0;
+	// false = every clip is read at load, set before the first acquire
+	bool lazy_clips = true;
+	// seconds a clip may go unused before update() drops it, 0 = never
+	float clip_evict_age = 0;
+	// clip reads and drops so far
+	unsigned int clip_loads = 0;
+	unsigned int clip_evictions = 0;
+
+	static ModelRegistry& get()
+	{
+		static ModelRegistry registry;
+		return registry;
+	}
+
+	//Models/<name>.gem, a model that does not load comes back empty (no meshes, no clips)
+	ModelData* acquire(Core* _core, Texture_Manager* _textures, const std::string& name, bool animated)
+	{
+		core = _core;
+		textures = _textures;
+		acquires++;
+		auto found = models.find(name);
+		if (found != models.end())
+		{
+			if (found->second->animated == animated)
+			{
+				found->second->users++;
+				return found->second;
+			}
+			std::cerr << "Model " << name << " is already loaded " << (animated ? "static" : "animated") << std::endl;
+			return &empty;
+		}
+		ModelData* data = new ModelData;
+		if (!load(textures, name, animated, *data))
+		{
+			delete data;
+			return &empty;
+		}
+		loads++;
+		data->users = 1;
+		models[name] = data;
+		return data;
+	}
+
+	void release(ModelData* data)
+	{
+		if (!data || data == &empty || --data->users > 0)
+			return;
+		models.erase(data->name);
+		// the last frame may still be drawing the meshes
+		core->flushGraphicsQueue();
+		for (Mesh* mesh : data->meshes)
+		{
+			mesh->free();
+			delete mesh;
+		}
+		delete data;
+	}
+
+	//hot reload of a static model: its .gem is checked (cooked) again, false keeps the old meshes
+	//Object users draw the new meshes as they are, Object_Instance ones rebuild theirs (generation)
+	bool reload(ModelData* data)
+	{
+		if (!data || data == &empty || data->animated)
+			return false;
+		ModelData fresh;
+		if (!load(textures, data->name, false, fresh))
+			return false;
+		// the last frame may still be drawing the old meshes
+		core->flushGraphicsQueue();
+		for (Mesh* mesh : data->meshes)
+		{
+			mesh->free();
+			delete mesh;
+		}
+		data->meshes.clear();
+		data->meshes.swap(fresh.meshes);
+		data->textureFilenames.swap(fresh.textureFilenames);
+		data->bounds = fresh.bounds;
+		data->generation++;
+		loads++;
+		return true;
+	}
+
+	//data->baked_palettes covers clips at rate, clips baked for other users at the same rate stay in
+	void bake(ModelData* data, const std::vector<ClipHandle>& clips, float rate)
+	{
+		BakedPalettes& baked = data->baked_palettes;
+		std::vector<ClipHandle> all;
+		bool missing = baked.rate != rate;
+		if (!missing)
+		{
+			for (ClipHandle clip = 0; clip < (ClipHandle)baked.clips.size(); clip++)
+			{
+				if (baked.contains(clip))
+					all.push_back(clip);
+			}
+		}
+		for (ClipHandle clip : clips)
+		{
+			if (!data->animation.validClip(clip) || baked.contains(clip))
+				continue;
+			missing = true;
+			all.push_back(clip);
+		}
+		if (!missing)
+			return;
+		for (ClipHandle clip : all)
+			use_clip(data, clip);
+		baked.bake(&data->animation, all, rate);
+	}
+
+	//a .gemc opened (and checked against its .gem) off the main thread, cooked is left empty
+	void add_opened(const std::string& path, GEMCookedModel& cooked)
+	{
+		opened[path].swap(cooked);
+	}
+
+	//once per path: a reload after that checks the .gem again
+	bool take_opened(const std::string& path, GEMCookedModel& out)
+	{
+		auto found = opened.find(path);
+		if (found == opened.end())
+			return false;
+		out.swap(found->second);
+		opened.erase(found);
+		return true;
+	}
+
+	//main thread, before clip is sampled (queued, baked, layered): loads it on its first use, keeps it from being evicted
+	void use_clip(ModelData* data, ClipHandle clip)
+	{
+		if (clip < 0 || clip >= (ClipHandle)data->clip_used.size())
+			return;
+		if (data->clip_used[clip] < 0)
+		{
+			load_gem_clip(data->cooked, data->clip_index[clip], *data->animation.clip(clip));
+			data->root_motion.extract_clip(&data->animation, clip);
+			clip_loads++;
+		}
+		data->clip_used[clip] = clock;
+	}
+
+	//main thread, once per frame
+	void update(float dt)
+	{
+		clock += dt;
+		if (clip_evict_age <= 0)
+			return;
+		float age = max(clip_evict_age, MODEL_CLIP_MIN_EVICT_AGE);
+		for (auto& model : models)
+		{
+			ModelData* data = model.second;
+			for (ClipHandle clip = 0; clip < (ClipHandle)data->clip_used.size(); clip++)
+			{
+				if (data->clip_used[clip] < 0 || clock - data->clip_used[clip] < age)
+					continue;
+				data->animation.clip(clip)->packed.release();
+				data->clip_used[clip] = -1.0f;
+				clip_evictions++;
+			}
+		}
+	}
+
+	//keyframe memory of the loaded clips
+	size_t resident_clip_bytes(const ModelData* data) const
+	{
+		size_t bytes = 0;
+		for (const AnimationSequence* clip : data->animation.clips)
+			bytes += clip->packed.resident() ? clip->memoryBytes() : 0;
+		return bytes;
+	}
+
+	void print() const
+	{
+		std::cout << "Models: " << models.size() << " loaded, " << loads << " .gem loads for " << acquires << " objects, "
+			<< clip_loads << " clip loads, " << clip_evictions << " evictions" << std::endl;
+		for (const auto& model : models)
+		{
+			const ModelData* data = model.second;
+			std::cout << "  " << model.first << ": " << data->users << " users, " << data->meshes.size() << " meshes";
+			if (!data->animation.clips.empty())
+			{
+				unsigned int resident = 0;
+				for (const AnimationSequence* clip : data->animation.clips)
+					resident += clip->packed.resident();
+				std::cout << ", " << resident << " / " << data->animation.clips.size() << " clips in memory, " << resident_clip_bytes(data) / 1024 << " KB";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+private:
+	Core* core = nullptr;
+	Texture_Manager* textures = nullptr;
+	std::unordered_map<std::string, ModelData*> models;
+	// by .gem path, until a load takes it
+	std::unordered_map<std::string, GEMCookedModel> opened;
+	ModelData empty;
+	// seconds of update() so far
+	float clock = 0;
+
+	bool load(Texture_Manager* textures, const std::string& name, bool animated, ModelData& data)
+	{
+		data.name = name;
+		data.path = "Models/" + name + ".gem";
+		data.animated = animated;
+		// cooked once into the .gemc: welded + reordered vertices, bounds, texture paths and packed clips, used in place
+		GEMCookedModel& cooked = data.cooked;
+		if (!take_opened(data.path, cooked) && !load_cooked_gem(data.path, cooked))
+			return false;
+		if (cooked.animated() != animated)
+		{
+			std::cerr << data.path << (animated ? " has no skinned meshes" : " has skinned meshes") << std::endl;
+			return false;
+		}
+		data.bounds.expand(cooked.bounds_min());
+		data.bounds.expand(cooked.bounds_max());
+		for (unsigned int i = 0; i < cooked.mesh_count(); i++)
+		{
+			//get all three textures file roots, the albedo one is the material name
+			std::string tex_root_alb = cooked.texture(i, 0);
+			std::vector<std::string> filenames;
+			filenames.push_back(tex_root_alb);
+			filenames.push_back(cooked.texture(i, 1));
+			filenames.push_back(cooked.texture(i, 2));
+			textures->load(core, tex_root_alb, filenames);
+			data.textureFilenames.push_back(tex_root_alb);
+
+			// welded + reordered when it was cooked
+			Mesh* mesh = new Mesh();
+			GEMSpan<unsigned int> indices = cooked.indices(i);
+			if (animated)
+			{
+				GEMSpan<ANIMATED_VERTEX> vertices = cooked.vertices_animated(i);
+				mesh->init_animation(core, vertices.data, vertices.size(), indices.data, indices.size());
+				data.skinning.add(vertices.data, vertices.size(), CPU_SKINNING_DEFAULT_STEP);
+			}
+			else
+			{
+				GEMSpan<STATIC_VERTEX> vertices = cooked.vertices_static(i);
+				mesh->init(core, vertices.data, vertices.size(), indices.data, indices.size());
+			}
+			data.meshes.push_back(mesh);
+		}
+		data.bounds.update_cache();
+
+		if (!animated)
+		{
+			cooked.close();
+			return true;
+		}
+		//Bones + clips, the clips are packed
+		load_gem_animation(cooked, data.animation, !lazy_clips);
+		if (!lazy_clips)
+		{
+			data.root_motion.extract(&data.animation);
+			cooked.close();
+			return true;
+		}
+		// clip directory only, root motion finds up from clip 0
+		data.clip_index.resize(data.animation.clips.size());
+		for (unsigned int i = 0; i < cooked.clip_count(); i++)
+			data.clip_index[data.animation.findClip(cooked.str(cooked.clip(i).name))] = i;
+		data.clip_used.assign(data.animation.clips.size(), -1.0f);
+		if (!data.clip_used.empty())
+		{
+			use_clip(&data, 0);
+			data.root_motion.init(&data.animation);
+			data.root_motion.extract_clip(&data.animation, 0);
+		}
+		return true;
+	}
+};
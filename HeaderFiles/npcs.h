@@ -19,6 +19,9 @@ public:
 	{
 		model.init(core, shader_manager, psos, textures, model_name);
 		model.init_hitbox(core, shader_manager, psos, true);
+		model.enable_skinned_bounds();
+		model.set_cross_fade(STATE_CROSS_FADE_TIME);
+		resolve_state_clips();
 
 		up = Vec3(0, 1, 0);
 		right = up.Cross(forward).Normalize();
@@ -116,7 +119,7 @@ public:
 			return;
 		}
 
-		if (dist < attack_range && AABB::AABB_intersect(model.hitbox.world_aabb, target->farmer.hitbox.world_aabb))
+		if (dist < attack_range && AABB::AABB_intersect(model.hitbox.hit_aabb(), target->farmer.hitbox.hit_aabb()))
 		{
 			do_attack();
 			return;
@@ -149,13 +152,28 @@ public:
 	{
 		update(dt, item_vec);
 		float ani_dt = dt * current_animation_speed;
-		model.draw(core, world_matrix, vp, ani_dt, state_helper[move_state]);
+		model.draw(core, world_matrix, vp, ani_dt, current_clip());
 
 		model.hitbox.update_from_world(hitbox_world_matrix);
 		model.hitbox.draw(core, hitbox_world_matrix, vp);
 
 	}
 
+	//after update(), the clip of the current state goes to the jobs
+	void queue_animation(AnimationJobs* jobs, float dt, Camera* camera)
+	{
+		model.select_lod(world_matrix, camera->position, camera->frustum);
+		model.queue_animation(jobs, dt * current_animation_speed, current_clip());
+	}
+
+	//after AnimationJobs::run
+	void draw_animated(Core* core, Matrix& vp)
+	{
+		model.draw_animated(core, world_matrix, vp);
+		model.hitbox.update_from_world(hitbox_world_matrix);
+		model.hitbox.draw(core, hitbox_world_matrix, vp);
+	}
+
 	void set_target(Main_Charactor* _target)
 	{
 		target = _target;
@@ -188,7 +206,11 @@ private:
 		forward = Matrix::rotateY(angle).mulVec(forward).Normalize();
 		right = up.Cross(forward).Normalize();
 
-		Vec3 next_pos = position + move_dir * speed * dt;
+		// the run plays at the rate its feet cover speed, the step is what they cover this frame
+		current_animation_speed = model.root_motion_rate(current_clip(), speed);
+		float step = model.root_motion_distance(current_clip(), dt * current_animation_speed, speed * dt);
+
+		Vec3 next_pos = position + move_dir * step;
 		AABB next_aabb = model.hitbox.local_aabb;
 		next_aabb = next_aabb.transform(return_next_world_matrix(next_pos));
 
@@ -197,7 +219,7 @@ private:
 			// make it slow down when turning
 			if (fabs(angle) < 0.2f)
 			{
-				position += move_dir * speed * dt;
+				position += move_dir * step;
 			}
 		}
 
@@ -209,6 +231,7 @@ private:
 
 		is_doing_action = true;
 		action_timer = 1.2f;
+		current_animation_speed = 1.0f;
 		move_state = NPC_State::ATTACK_01;
 	}
 
@@ -0,0 +1,300 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include "vectors.h"
+#include "pose.h"
+
+//Packed animation clip
+/*
+– the loader gives every frame three std::vectors (positions, rotations, scales), 3 allocations per frame
+– the packed clip keeps all keyframes of a clip in one unsigned short buffer:
+	| frame 0: rotations | positions | scales | frame 1: ... |
+	only animated tracks are in the buffer, the per frame stride is the same for every frame
+– constant tracks (all frames equal within a tolerance) keep one float value in the bone table
+– rotations: smallest three, 48 bits
+	• the largest component is dropped and rebuilt as sqrt(1 - a² - b² - c²)
+	• the other three are in [-1/sqrt2, 1/sqrt2], 15 bits each
+	• 2 bit index of the dropped component in the top bits of the first two shorts
+– positions and scales: 16 bits per component, quantised over the track's min..max
+– neighbouring keyframes are usually close, rotations between them nlerp (no acos / sin) unless the arc is wide
+– the .gemc cache holds packed clips, a change to the packing needs GEM_COOKER_VERSION (gem_cooked.h) bumped
+*/
+
+#define PACKED_CLIP_ROTATION_TOLERANCE 0.00001f
+#define PACKED_CLIP_POSITION_TOLERANCE 0.0001f
+#define PACKED_CLIP_SCALE_TOLERANCE 0.00001f
+#define PACKED_CLIP_NOT_ANIMATED -1
+
+// 1/sqrt(2), the largest a dropped component can make the other three
+#define PACKED_CLIP_QUAT_RANGE 0.70710678f
+#define PACKED_CLIP_QUAT_MAX 32767.0f
+#define PACKED_CLIP_RANGE_MAX 65535.0f
+// |dot| above this (about 7 degrees apart) nlerp is within 1e-4 of slerp
+#define PACKED_CLIP_NLERP_DOT 0.998f
+
+struct PackedBoneTracks
+{
+	// offset of the track in a frame, PACKED_CLIP_NOT_ANIMATED for constant tracks
+	int rotation = PACKED_CLIP_NOT_ANIMATED;
+	int position = PACKED_CLIP_NOT_ANIMATED;
+	int scale = PACKED_CLIP_NOT_ANIMATED;
+	// constant value, or the min of an animated range track
+	Quaternion rotation_value;
+	Vec3 position_min;
+	Vec3 scale_min;
+	// (max - min) / 65535, one quantisation step
+	Vec3 position_step;
+	Vec3 scale_step;
+};
+
+class PackedClip
+{
+public:
+	std::vector<PackedBoneTracks> bones;
+	std::vector<unsigned short> data;
+	unsigned int frame_count = 0;
+	// unsigned shorts per frame
+	unsigned int stride = 0;
+
+	bool empty() const
+	{
+		return frame_count == 0;
+	}
+
+	//tracks + keyframes are in memory, a lazily loaded clip starts without them
+	bool resident() const
+	{
+		return !bones.empty();
+	}
+
+	//drop the tracks + keyframes, frame_count and stride stay so the clip keeps its duration
+	void release()
+	{
+		std::vector<PackedBoneTracks>().swap(bones);
+		std::vector<unsigned short>().swap(data);
+	}
+
+	unsigned int animated_tracks() const
+	{
+		unsigned int count = 0;
+		for (const PackedBoneTracks& b : bones)
+			count += (b.rotation >= 0) + (b.position >= 0) + (b.scale >= 0);
+		return count;
+	}
+
+	size_t memory_bytes() const
+	{
+		return sizeof(PackedClip) + bones.capacity() * sizeof(PackedBoneTracks) + data.capacity() * sizeof(unsigned short);
+	}
+
+	//FRAME needs positions, rotations and scales vectors, one entry per bone
+	template<typename FRAME>
+	void build(const std::vector<FRAME>& frames)
+	{
+		bones.clear();
+		data.clear();
+		stride = 0;
+		frame_count = (unsigned int)frames.size();
+		if (frames.empty())
+			return;
+
+		unsigned int bone_count = (unsigned int)frames[0].rotations.size();
+		bones.resize(bone_count);
+
+		// pick the animated tracks, rotations first so each frame has them together
+		for (unsigned int b = 0; b < bone_count; b++)
+		{
+			PackedBoneTracks& tracks = bones[b];
+			tracks.rotation_value = normalized(frames[0].rotations[b]);
+			for (const FRAME& f : frames)
+			{
+				if (!same_rotation(tracks.rotation_value, normalized(f.rotations[b])))
+				{
+					tracks.rotation = stride;
+					stride += 3;
+					break;
+				}
+			}
+		}
+		for (unsigned int b = 0; b < bone_count; b++)
+		{
+			tracks_range(frames, b, true, bones[b].position_min, bones[b].position_step, bones[b].position);
+		}
+		for (unsigned int b = 0; b < bone_count; b++)
+		{
+			tracks_range(frames, b, false, bones[b].scale_min, bones[b].scale_step, bones[b].scale);
+		}
+
+		data.resize((size_t)stride * frame_count);
+		for (unsigned int n = 0; n < frame_count; n++)
+		{
+			unsigned short* frame = &data[(size_t)n * stride];
+			for (unsigned int b = 0; b < bone_count; b++)
+			{
+				const PackedBoneTracks& tracks = bones[b];
+				if (tracks.rotation >= 0)
+					encode_rotation(normalized(frames[n].rotations[b]), frame + tracks.rotation);
+				if (tracks.position >= 0)
+					encode_range(frames[n].positions[b], tracks.position_min, tracks.position_step, frame + tracks.position);
+				if (tracks.scale >= 0)
+					encode_range(frames[n].scales[b], tracks.scale_min, tracks.scale_step, frame + tracks.scale);
+			}
+		}
+	}
+
+	//decode one bone at one frame
+	void decode(unsigned int frame_index, unsigned int bone, Vec3& position, Quaternion& rotation, Vec3& scale) const
+	{
+		const PackedBoneTracks& tracks = bones[bone];
+		const unsigned short* frame = stride ? &data[(size_t)frame_index * stride] : nullptr;
+		rotation = tracks.rotation >= 0 ? decode_rotation(frame + tracks.rotation) : tracks.rotation_value;
+		position = tracks.position >= 0 ? decode_range(frame + tracks.position, tracks.position_min, tracks.position_step) : tracks.position_min;
+		scale = tracks.scale >= 0 ? decode_range(frame + tracks.scale, tracks.scale_min, tracks.scale_step) : tracks.scale_min;
+	}
+
+	//two neighbouring frames of one bone
+	void sample(unsigned int frame_index, unsigned int next_index, float t, unsigned int bone,
+		Vec3& position, Quaternion& rotation, Vec3& scale) const
+	{
+		const PackedBoneTracks& tracks = bones[bone];
+		const unsigned short* frame = stride ? &data[(size_t)frame_index * stride] : nullptr;
+		const unsigned short* next = stride ? &data[(size_t)next_index * stride] : nullptr;
+
+		// constant tracks skip both the decode and the interpolation
+		if (tracks.rotation >= 0)
+			rotation = interpolate_rotation(decode_rotation(frame + tracks.rotation), decode_rotation(next + tracks.rotation), t);
+		else
+			rotation = tracks.rotation_value;
+
+		if (tracks.position >= 0)
+			position = lerp(decode_range(frame + tracks.position, tracks.position_min, tracks.position_step),
+				decode_range(next + tracks.position, tracks.position_min, tracks.position_step), t);
+		else
+			position = tracks.position_min;
+
+		if (tracks.scale >= 0)
+			scale = lerp(decode_range(frame + tracks.scale, tracks.scale_min, tracks.scale_step),
+				decode_range(next + tracks.scale, tracks.scale_min, tracks.scale_step), t);
+		else
+			scale = tracks.scale_min;
+	}
+
+	static void encode_rotation(Quaternion q, unsigned short* out)
+	{
+		unsigned int largest = 0;
+		for (unsigned int i = 1; i < 4; i++)
+		{
+			if (fabsf(q.q[i]) > fabsf(q.q[largest]))
+				largest = i;
+		}
+		// q and -q are the same rotation, keep the dropped one positive
+		if (q.q[largest] < 0)
+			q = -q;
+		unsigned int k = 0;
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float v = (clamp(q.q[i], -PACKED_CLIP_QUAT_RANGE, PACKED_CLIP_QUAT_RANGE) + PACKED_CLIP_QUAT_RANGE) / (2.0f * PACKED_CLIP_QUAT_RANGE);
+			out[k++] = (unsigned short)(v * PACKED_CLIP_QUAT_MAX + 0.5f);
+		}
+		out[0] |= (unsigned short)((largest & 1) << 15);
+		out[1] |= (unsigned short)((largest >> 1) << 15);
+	}
+
+	static Quaternion decode_rotation(const unsigned short* in)
+	{
+		const float scale = 2.0f * PACKED_CLIP_QUAT_RANGE / PACKED_CLIP_QUAT_MAX;
+		unsigned int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+		float x = (in[0] & 0x7FFF) * scale - PACKED_CLIP_QUAT_RANGE;
+		float y = (in[1] & 0x7FFF) * scale - PACKED_CLIP_QUAT_RANGE;
+		float z = (in[2] & 0x7FFF) * scale - PACKED_CLIP_QUAT_RANGE;
+		float w = sqrtf(max(0.0f, 1.0f - x * x - y * y - z * z));
+		switch (largest)
+		{
+		case 0: return Quaternion(w, x, y, z);
+		case 1: return Quaternion(x, w, y, z);
+		case 2: return Quaternion(x, y, w, z);
+		default: return Quaternion(x, y, z, w);
+		}
+	}
+
+	static void encode_range(const Vec3& v, const Vec3& v_min, const Vec3& step, unsigned short* out)
+	{
+		out[0] = quantise(v.x, v_min.x, step.x);
+		out[1] = quantise(v.y, v_min.y, step.y);
+		out[2] = quantise(v.z, v_min.z, step.z);
+	}
+
+	static Vec3 decode_range(const unsigned short* in, const Vec3& v_min, const Vec3& step)
+	{
+		return Vec3(v_min.x + in[0] * step.x, v_min.y + in[1] * step.y, v_min.z + in[2] * step.z);
+	}
+
+private:
+	static Quaternion interpolate_rotation(const Quaternion& a, const Quaternion& b, float t)
+	{
+		float dp = fabsf(a.a * b.a + a.b * b.b + a.c * b.c + a.d * b.d);
+		if (dp > PACKED_CLIP_NLERP_DOT)
+			return PoseBlend::nlerp(a, b, t);
+		return Quaternion::slerp(a, b, t);
+	}
+
+	static Vec3 lerp(const Vec3& a, const Vec3& b, float t)
+	{
+		return (a * (1.0f - t)) + (b * t);
+	}
+
+	static Quaternion normalized(Quaternion q)
+	{
+		float length = q.Mangnitude();
+		return length > 0 ? q * (1.0f / length) : Quaternion(0, 0, 0, 1);
+	}
+
+	static bool same_rotation(const Quaternion& a, const Quaternion& b)
+	{
+		// compare with the sign that makes them closest
+		float sign = (a.a * b.a + a.b * b.b + a.c * b.c + a.d * b.d) < 0 ? -1.0f : 1.0f;
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			if (fabsf(a.q[i] - sign * b.q[i]) > PACKED_CLIP_ROTATION_TOLERANCE)
+				return false;
+		}
+		return true;
+	}
+
+	static unsigned short quantise(float v, float v_min, float step)
+	{
+		if (step <= 0)
+			return 0;
+		float q = (v - v_min) / step + 0.5f;
+		return (unsigned short)clamp(q, 0.0f, PACKED_CLIP_RANGE_MAX);
+	}
+
+	//min + step of a position or scale track, offset stays PACKED_CLIP_NOT_ANIMATED when it is constant
+	template<typename FRAME>
+	void tracks_range(const std::vector<FRAME>& frames, unsigned int bone, bool positions, Vec3& v_min, Vec3& step, int& offset)
+	{
+		const float tolerance = positions ? PACKED_CLIP_POSITION_TOLERANCE : PACKED_CLIP_SCALE_TOLERANCE;
+		v_min = positions ? frames[0].positions[bone] : frames[0].scales[bone];
+		Vec3 v_max = v_min;
+		for (const FRAME& f : frames)
+		{
+			const Vec3& v = positions ? f.positions[bone] : f.scales[bone];
+			v_min = Min(v_min, v);
+			v_max = Max(v_max, v);
+		}
+		Vec3 extent = v_max - v_min;
+		step = Vec3(0, 0, 0);
+		if (extent.x <= tolerance && extent.y <= tolerance && extent.z <= tolerance)
+		{
+			// constant, keep the middle of the tiny range
+			v_min = (v_min + v_max) * 0.5f;
+			return;
+		}
+		step = extent * (1.0f / PACKED_CLIP_RANGE_MAX);
+		offset = stride;
+		stride += 3;
+	}
+};
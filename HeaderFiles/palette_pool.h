@@ -0,0 +1,132 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "vectors.h"
+
+//Palette pool
+/*
+– skinning palettes are sized to the skeleton instead of a fixed Matrix[256]
+– matrices come from big chunks (bump allocated), a released palette goes on a free list for its size
+– most characters share a handful of skeletons, so the free lists are reused exactly
+– Palette owns one allocation and gives it back on destruction, it can be moved but not copied
+*/
+
+// matrices per chunk, 256KB
+#define PALETTE_POOL_CHUNK_MATRICES 4096
+
+class PalettePool
+{
+public:
+	Matrix* acquire(unsigned int count)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = free_lists.find(count);
+		if (it != free_lists.end() && !it->second.empty())
+		{
+			Matrix* m = it->second.back();
+			it->second.pop_back();
+			return m;
+		}
+		// too big for a chunk, it gets a chunk of its own
+		if (count > PALETTE_POOL_CHUNK_MATRICES)
+		{
+			chunks.emplace_back(new Matrix[count]);
+			reserved += count;
+			return chunks.back().get();
+		}
+		if (chunks_used + count > PALETTE_POOL_CHUNK_MATRICES || current == nullptr)
+		{
+			chunks.emplace_back(new Matrix[PALETTE_POOL_CHUNK_MATRICES]);
+			current = chunks.back().get();
+			chunks_used = 0;
+			reserved += PALETTE_POOL_CHUNK_MATRICES;
+		}
+		Matrix* m = current + chunks_used;
+		chunks_used += count;
+		return m;
+	}
+
+	void release(Matrix* m, unsigned int count)
+	{
+		if (m == nullptr)
+			return;
+		std::lock_guard<std::mutex> lock(mutex);
+		free_lists[count].push_back(m);
+	}
+
+	size_t reserved_bytes() const
+	{
+		return reserved * sizeof(Matrix);
+	}
+
+	//the pool every AnimationInstance uses unless it is given another one
+	static PalettePool& shared()
+	{
+		static PalettePool pool;
+		return pool;
+	}
+
+private:
+	std::vector<std::unique_ptr<Matrix[]>> chunks;
+	Matrix* current = nullptr;
+	unsigned int chunks_used = 0;
+	size_t reserved = 0;
+	std::unordered_map<unsigned int, std::vector<Matrix*>> free_lists;
+	std::mutex mutex;
+};
+
+class Palette
+{
+public:
+	Matrix* data = nullptr;
+	unsigned int count = 0;
+
+	Palette() {}
+	~Palette()
+	{
+		reset();
+	}
+	Palette(const Palette&) = delete;
+	Palette& operator=(const Palette&) = delete;
+	Palette(Palette&& other) noexcept : data(other.data), count(other.count), pool(other.pool)
+	{
+		other.data = nullptr;
+		other.count = 0;
+	}
+	Palette& operator=(Palette&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			data = other.data;
+			count = other.count;
+			pool = other.pool;
+			other.data = nullptr;
+			other.count = 0;
+		}
+		return *this;
+	}
+
+	void acquire(PalettePool* _pool, unsigned int _count)
+	{
+		if (data && pool == _pool && count == _count)
+			return;
+		reset();
+		pool = _pool;
+		count = _count;
+		data = pool->acquire(count);
+	}
+
+	void reset()
+	{
+		if (data)
+			pool->release(data, count);
+		data = nullptr;
+		count = 0;
+	}
+
+private:
+	PalettePool* pool = nullptr;
+};
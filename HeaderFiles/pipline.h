@@ -99,6 +99,8 @@ class PSOManager
 {
 public:
 	std::unordered_map<std::string, ID3D12PipelineState*> psos;
+	// small integer per PSO name, for render queue sort keys
+	std::unordered_map<std::string, unsigned int> ids;
 
 	//Pipeline State Objects
 	//– Call after creating shaders and layout
@@ -274,6 +276,16 @@ public:
 		core->getCommandList()->SetPipelineState(psos[name]);
 	}
 
+	unsigned int get_id(std::string name)
+	{
+		auto it = ids.find(name);
+		if (it != ids.end())
+			return it->second;
+		unsigned int id = (unsigned int)ids.size();
+		ids.insert({ name, id });
+		return id;
+	}
+
 	void createPSO_UI(Core* core, std::string name, ID3DBlob* vs, ID3DBlob* ps, D3D12_INPUT_LAYOUT_DESC layout)
 	{
 		//– Check if PSO in map
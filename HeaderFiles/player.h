@@ -4,6 +4,9 @@
 #include <string>
 #include "map_item.h"
 
+// seconds a state change blends from the old clip to the new one
+#define STATE_CROSS_FADE_TIME 0.2f
+
 enum class NPC_State
 {
 	ATTACK_01 = 0,
@@ -101,6 +104,8 @@ public:
 
 	NPC_State move_state;
 	NPC_State_Helper state_helper;
+	// state -> clip handle, resolved once after the model is loaded
+	std::array<ClipHandle, static_cast<size_t>(NPC_State::MAX_TYPE)> state_clips;
 
 	float current_animation_speed = 1.0f;
 
@@ -130,6 +135,8 @@ public:
 	virtual void init(Core* core, Shader_Manager* shader_manager, PSOManager* psos, Texture_Manager* textures, std::string model_name)
 	{
 		model.init(core, shader_manager, psos, textures, model_name);
+		model.set_cross_fade(STATE_CROSS_FADE_TIME);
+		resolve_state_clips();
 
 		up = Vec3(0, 1, 0);
 		right = up.Cross(forward).Normalize();
@@ -137,6 +144,19 @@ public:
 
 	virtual void update(float dt, std::vector<Item_Ins_Base*> item_vec) = 0;
 
+	void resolve_state_clips()
+	{
+		for (size_t i = 0; i < state_clips.size(); i++)
+		{
+			state_clips[i] = model.find_clip(state_helper.state_names[i]);
+		}
+	}
+
+	ClipHandle current_clip()
+	{
+		return state_clips[static_cast<size_t>(move_state)];
+	}
+
 	virtual void suffer_attack(float damage)
 	{
 		if (health > 0 && !is_dead)
@@ -295,6 +315,8 @@ public:
 	//bool is_running = false;
 	Charactor_State move_state;
 	Charactor_State_Helper move_state_helper;
+	// state -> clip handle, resolved once in init
+	std::array<ClipHandle, static_cast<size_t>(Charactor_State::MAX_TYPE)> move_state_clips;
 	float current_animation_speed = 1.0f;
 	//state control
 	bool is_carrying = false;
@@ -307,10 +329,17 @@ public:
 	void init(Core* core, Shader_Manager* shader_manager, PSOManager* psos,Texture_Manager* textures, Camera* cam)
 	{
 		farmer.init(core, shader_manager, psos, textures, name);
+		farmer.set_cross_fade(STATE_CROSS_FADE_TIME);
+		for (size_t i = 0; i < move_state_clips.size(); i++)
+		{
+			move_state_clips[i] = farmer.find_clip(move_state_helper.state_names[i]);
+		}
 		//std::cout << farmer.hitbox.local_aabb.getMax().get_string() << farmer.hitbox.local_aabb.getMin().get_string() << std::endl;
 		farmer.hitbox.local_aabb.m_min.x = -40.0f;
 		farmer.hitbox.local_aabb.m_max.x = 40.0f;
 		farmer.init_hitbox(core, shader_manager, psos, true);
+		// attack + pickup boxes follow the swing instead of the bind pose
+		farmer.enable_skinned_bounds();
 
 		//position = Vec3(x_offset, y_offset, ground_offset);
 		position = Vec3(0, 0, 0);
@@ -476,6 +505,10 @@ public:
 
 				speed = is_carrying ? 70.0f : 100.0f;
 			}
+			// the clip plays at the rate its feet cover speed, the step is what they cover this frame
+			ClipHandle clip = move_state_clips[static_cast<size_t>(move_state)];
+			current_animation_speed = farmer.root_motion_rate(clip, speed);
+			s = farmer.root_motion_distance(clip, dt * current_animation_speed, speed * dt);
 			move_dir = move_dir.Normalize();
 
 			Vec3 current_forward = forward;
@@ -511,13 +544,22 @@ public:
 		}
 		else
 		{
-			//current_animation_speed = 1.0f;
+			current_animation_speed = 1.0f;
 			move_state = is_carrying? Charactor_State::IDLE_WHEELBARROW : Charactor_State::IDLE_BASIC_01;
 			//move_state = Charactor_State::IDLE_BASIC_01;
 		}
 
 		update_world_matrix();
 	}
+	//every action starts here, speed is its own rate and not whatever the locomotion clip played at
+	void start_action(Charactor_State state, float duration, float speed = 1.0f)
+	{
+		is_doing_action = true;
+		action_timer = duration;
+		current_animation_speed = speed;
+		move_state = state;
+	}
+
 	// check and reset the charactor state
 	void update_action(float dt)
 	{
@@ -545,23 +587,13 @@ public:
 
 		if (window->mouseButtons[0])
 		{
-			is_doing_action = true;
-			action_timer = 1.6f;
-
-			current_animation_speed = 2.0f;
-
-			move_state = Charactor_State::ATTACK_A;
+			start_action(Charactor_State::ATTACK_A, 1.6f, 2.0f);
 			return;
 		}
 
 		if (window->keys['E'] && !is_carrying)
 		{
-			is_doing_action = true;
-			action_timer = 2.5f;
-
-			current_animation_speed = 2.0f;
-
-			move_state = Charactor_State::GRAB_LOW;
+			start_action(Charactor_State::GRAB_LOW, 2.5f, 2.0f);
 			is_carrying = true;
 			return;
 		}
@@ -570,7 +602,7 @@ public:
 	AABB make_attack_aabb(float range = 60.0f)
 	{
 		AABB atk;
-		Vec3 center = farmer.hitbox.world_aabb.get_center();
+		Vec3 center = farmer.hitbox.hit_aabb().get_center();
 
 		Vec3 forward_offset = forward * range;
 
@@ -587,7 +619,7 @@ public:
 
 		for (NPC_Base* enemy : enemies)
 		{
-			if (AABB::AABB_intersect(attack_box, enemy->model.hitbox.world_aabb))
+			if (AABB::AABB_intersect(attack_box, enemy->model.hitbox.hit_aabb()))
 			{
 				enemy->suffer_attack(attack);
 				enemy->is_be_attacking = true;
@@ -604,11 +636,7 @@ public:
 
 		if (window->mouseButtons[0] && !is_carrying)
 		{
-			is_doing_action = true;
-			action_timer = 1.0f;
-
-			current_animation_speed = 2.0f;
-			move_state = Charactor_State::ATTACK_A;
+			start_action(Charactor_State::ATTACK_A, 1.0f, 2.0f);
 
 			try_attack(enemies);
 		}
@@ -617,11 +645,11 @@ public:
 
 	bool try_pickup(const std::vector<NPC_Base*>& items)
 	{
-		AABB pickup_box = farmer.hitbox.world_aabb;
+		AABB pickup_box = farmer.hitbox.hit_aabb();
 
 		for (NPC_Base* item : items)
 		{
-			if (AABB::AABB_intersect(pickup_box, item->model.hitbox.world_aabb) && item->is_dead)
+			if (AABB::AABB_intersect(pickup_box, item->model.hitbox.hit_aabb()) && item->is_dead)
 			{
 				item->is_be_holding = true;
 				carrying_item = item;
@@ -641,12 +669,7 @@ public:
 			// try carray
 			if (!is_carrying)
 			{
-				is_doing_action = true;
-				action_timer = 1.0f;
-
-				current_animation_speed = 2.0f;
-
-				move_state = Charactor_State::GRAB_LOW;
+				start_action(Charactor_State::GRAB_LOW, 1.0f, 2.0f);
 				if (try_pickup(items))
 				{
 					is_carrying = true;
@@ -654,10 +677,8 @@ public:
 			}
 			else
 			{
-				is_doing_action = true;
-				action_timer = 0.5f;
-
-				move_state = Charactor_State::GRAB_LOW;
+				// put down at the clip's own rate, not the WALK_CARRY one
+				start_action(Charactor_State::GRAB_LOW, 0.5f);
 				is_carrying = false;
 
 				if(carrying_item != nullptr)
@@ -677,12 +698,27 @@ public:
 	{
 		update(core, wnd, dt, npcs, items);
 		float ani_dt =  dt * current_animation_speed;
-		farmer.draw(core, world_matrix, camera->view_projection, ani_dt, move_state_helper[move_state]);
+		farmer.draw(core, world_matrix, camera->view_projection, ani_dt, move_state_clips[static_cast<size_t>(move_state)]);
 		// update hitbox pos
 		farmer.hitbox.update_from_world(hitbox_world_matrix);
 		farmer.hitbox.draw(core, hitbox_world_matrix, camera->view_projection);
 	}
 
+	//after update(), the clip of the current state goes to the jobs
+	void queue_animation(AnimationJobs* jobs, float dt)
+	{
+		farmer.select_lod(world_matrix, camera->position, camera->frustum);
+		farmer.queue_animation(jobs, dt * current_animation_speed, move_state_clips[static_cast<size_t>(move_state)]);
+	}
+
+	//after AnimationJobs::run
+	void draw_animated(Core* core)
+	{
+		farmer.draw_animated(core, world_matrix, camera->view_projection);
+		farmer.hitbox.update_from_world(hitbox_world_matrix);
+		farmer.hitbox.draw(core, hitbox_world_matrix, camera->view_projection);
+	}
+
 	private:
 		float signed_angle_y(const Vec3& from, const Vec3& to)
 		{
@@ -0,0 +1,139 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include "vectors.h"
+
+//Local pose + blending
+/*
+– a clip is sampled into a LocalPose, one TRS per bone in the parent's space
+– poses are blended in local space, the parent * local walk and the final transforms run once after
+– blend operations, all take a per bone weight mask (nullptr = every bone):
+	• lerp:     out = a + (b - a) * w, rotations nlerp on the short arc
+	• additive: out = base + (pose - reference) * w, the reference is usually frame 0 of the additive clip
+*/
+
+enum Blend_Mode
+{
+	BLEND_LERP = 0,
+	BLEND_ADDITIVE = 1
+};
+
+struct BonePose
+{
+	Vec3 position;
+	Quaternion rotation;
+	Vec3 scale;
+
+	//T * R * S, written out instead of two matrix multiplies
+	Matrix toMatrix() const
+	{
+		Matrix m = rotation.toMatrix();
+		m.m[0] *= scale.x; m.m[1] *= scale.y; m.m[2] *= scale.z; m.m[3] = position.x;
+		m.m[4] *= scale.x; m.m[5] *= scale.y; m.m[6] *= scale.z; m.m[7] = position.y;
+		m.m[8] *= scale.x; m.m[9] *= scale.y; m.m[10] *= scale.z; m.m[11] = position.z;
+		return m;
+	}
+};
+
+struct LocalPose
+{
+	std::vector<BonePose> bones;
+
+	// only grows, no allocations once every pose has seen the skeleton
+	void resize(int count)
+	{
+		if ((int)bones.size() != count)
+			bones.resize(count);
+	}
+
+	int count() const
+	{
+		return (int)bones.size();
+	}
+};
+
+class PoseBlend
+{
+public:
+	//out = a -> b by weight, out can be a or b
+	static void lerp(const LocalPose& a, const LocalPose& b, float weight, LocalPose& out, const float* mask = nullptr)
+	{
+		out.resize(a.count());
+		for (int i = 0; i < a.count(); i++)
+		{
+			float w = mask ? weight * mask[i] : weight;
+			const BonePose& pa = a.bones[i];
+			const BonePose& pb = b.bones[i];
+			BonePose& po = out.bones[i];
+			if (w <= 0.0f)
+			{
+				po = pa;
+				continue;
+			}
+			if (w >= 1.0f)
+			{
+				po = pb;
+				continue;
+			}
+			po.position = pa.position + (pb.position - pa.position) * w;
+			po.scale = pa.scale + (pb.scale - pa.scale) * w;
+			po.rotation = nlerp(pa.rotation, pb.rotation, w);
+		}
+	}
+
+	//out = base + (pose - reference) * weight, out can be base
+	static void additive(const LocalPose& base, const LocalPose& pose, const LocalPose& reference, float weight,
+		LocalPose& out, const float* mask = nullptr)
+	{
+		out.resize(base.count());
+		for (int i = 0; i < base.count(); i++)
+		{
+			float w = mask ? weight * mask[i] : weight;
+			const BonePose& pb = base.bones[i];
+			BonePose& po = out.bones[i];
+			if (w <= 0.0f)
+			{
+				po = pb;
+				continue;
+			}
+			const BonePose& pp = pose.bones[i];
+			const BonePose& pr = reference.bones[i];
+			// delta rotation in the bone's space, pose = reference * delta
+			Quaternion delta = multiply(conjugate(pr.rotation), pp.rotation);
+			if (w < 1.0f)
+				delta = nlerp(Quaternion(0, 0, 0, 1), delta, w);
+			po.position = pb.position + (pp.position - pr.position) * w;
+			po.scale = Vec3(pb.scale.x * (1.0f + (ratio(pp.scale.x, pr.scale.x) - 1.0f) * w),
+				pb.scale.y * (1.0f + (ratio(pp.scale.y, pr.scale.y) - 1.0f) * w),
+				pb.scale.z * (1.0f + (ratio(pp.scale.z, pr.scale.z) - 1.0f) * w));
+			po.rotation = multiply(pb.rotation, delta);
+		}
+	}
+
+	//normalised lerp on the short arc, close enough to slerp for blend weights and much cheaper
+	static Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t)
+	{
+		float dp = a.a * b.a + a.b * b.b + a.c * b.c + a.d * b.d;
+		float tb = dp < 0 ? -t : t;
+		float ta = 1.0f - t;
+		Quaternion q(a.a * ta + b.a * tb, a.b * ta + b.b * tb, a.c * ta + b.c * tb, a.d * ta + b.d * tb);
+		float length = q.Mangnitude();
+		return length > 0 ? q * (1.0f / length) : a;
+	}
+
+private:
+	static Quaternion conjugate(const Quaternion& q)
+	{
+		return Quaternion(-q.a, -q.b, -q.c, q.d);
+	}
+
+	static Quaternion multiply(Quaternion a, const Quaternion& b)
+	{
+		return a * b;
+	}
+
+	static float ratio(float v, float reference)
+	{
+		return reference != 0 ? v / reference : 1.0f;
+	}
+};
@@ -0,0 +1,220 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "core.h"
+#include "mesh.h"
+#include "shader.h"
+#include "pipline.h"
+#include "textureloader.h"
+
+//Render queue
+/*
+– objects submit one DrawItem per mesh instead of drawing straight away
+– every item carries a 64-bit sort key, flush() sorts the keys and replays the draws
+– replay only touches state that changed since the previous draw:
+	• SetPipelineState
+	• SetGraphicsRootDescriptorTable (material textures)
+	• SetGraphicsRootConstantBufferView (meshes of one object share the same CB slot)
+– key layout
+	opaque: | pass 4 | pso 12 | material 16 | depth 32 |   state first, then front to back
+	alpha:  | pass 4 | ~depth 32 | pso 12 | material 16 |   back to front first, state second
+– depth is a non negative float, its bit pattern already sorts like an unsigned int
+*/
+
+enum Render_Pass
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_ALPHA = 1
+};
+
+struct RenderStats
+{
+	unsigned int draws = 0;
+	unsigned int pso_binds = 0;
+	unsigned int pso_skipped = 0;
+	unsigned int table_binds = 0;
+	unsigned int table_skipped = 0;
+	unsigned int cbv_binds = 0;
+	unsigned int cbv_skipped = 0;
+
+	void print() const
+	{
+		std::cout << "draws: " << draws
+			<< " pso binds: " << pso_binds << " (skipped " << pso_skipped << ")"
+			<< " texture tables: " << table_binds << " (skipped " << table_skipped << ")"
+			<< " cbvs: " << cbv_binds << " (skipped " << cbv_skipped << ")" << std::endl;
+	}
+};
+
+typedef void (*Draw_Func)(Core* core, void* mesh);
+
+struct DrawItem
+{
+	unsigned long long key;
+	ID3D12PipelineState* pso;
+	D3D12_GPU_DESCRIPTOR_HANDLE table;
+	// root slot of the vertex shader CB, 0 for the animated root parameter, 3 for the static one
+	unsigned int vs_slot;
+	D3D12_GPU_VIRTUAL_ADDRESS vs_cb;
+	D3D12_GPU_VIRTUAL_ADDRESS ps_cb;
+	void* mesh;
+	Draw_Func draw;
+};
+
+//per object state looked up once, so submitting does no string lookups
+struct RenderBinding
+{
+	ID3D12PipelineState* pso = nullptr;
+	unsigned int pso_id = 0;
+	Shader* vs = nullptr;
+	Shader* ps = nullptr;
+	std::vector<unsigned int> material_ids;
+	std::vector<D3D12_GPU_DESCRIPTOR_HANDLE> tables;
+
+	void resolve(Core* core, PSOManager* psos, Shader_Manager* shader_manager, Texture_Manager* textures,
+		const std::string& pso_name, const std::string& vs_name, const std::string& ps_name, const std::vector<std::string>& materials)
+	{
+		pso = psos->psos[pso_name];
+		pso_id = psos->get_id(pso_name);
+		vs = shader_manager->find(vs_name);
+		ps = shader_manager->find(ps_name);
+		material_ids.clear();
+		tables.clear();
+		for (const std::string& material : materials)
+		{
+			material_ids.push_back(textures->get_material_id(material));
+			tables.push_back(textures->get_material_GPU_handle(core, material));
+		}
+	}
+
+	//same walk as the objects' apply(), records the addresses instead of binding them
+	void capture(D3D12_GPU_VIRTUAL_ADDRESS& vs_cb, D3D12_GPU_VIRTUAL_ADDRESS& ps_cb)
+	{
+		vs_cb = 0;
+		ps_cb = 0;
+		for (auto& cb : vs->constantBuffers)
+		{
+			vs_cb = cb.second.getGPUAddress();
+			cb.second.next();
+		}
+		for (auto& cb : ps->constantBuffers)
+		{
+			ps_cb = cb.second.getGPUAddress();
+			cb.second.next();
+		}
+	}
+};
+
+class RenderQueue
+{
+public:
+	std::vector<DrawItem> items;
+	// counts of the last flush
+	RenderStats stats;
+
+	static unsigned long long make_key(Render_Pass pass, unsigned int pso_id, unsigned int material_id, float depth)
+	{
+		depth = max(depth, 0.0f);
+		unsigned int depth_bits;
+		memcpy(&depth_bits, &depth, sizeof(float));
+
+		unsigned long long key = (unsigned long long)(pass & 0xF) << 60;
+		if (pass == RENDER_PASS_ALPHA)
+		{
+			key |= (unsigned long long)(~depth_bits) << 28;
+			key |= (unsigned long long)(pso_id & 0xFFF) << 16;
+			key |= (unsigned long long)(material_id & 0xFFFF);
+		}
+		else
+		{
+			key |= (unsigned long long)(pso_id & 0xFFF) << 48;
+			key |= (unsigned long long)(material_id & 0xFFFF) << 32;
+			key |= (unsigned long long)depth_bits;
+		}
+		return key;
+	}
+
+	//view depth of the object origin, w of the clip position
+	static float view_depth(const Matrix& vp, const Matrix& world)
+	{
+		return vp.a[3][0] * world.m[3] + vp.a[3][1] * world.m[7] + vp.a[3][2] * world.m[11] + vp.a[3][3];
+	}
+
+	void submit(unsigned long long key, const RenderBinding& binding, unsigned int mesh_index,
+		unsigned int vs_slot, D3D12_GPU_VIRTUAL_ADDRESS vs_cb, D3D12_GPU_VIRTUAL_ADDRESS ps_cb, Mesh* mesh)
+	{
+		items.push_back({ key, binding.pso, binding.tables[mesh_index], vs_slot, vs_cb, ps_cb, mesh,
+			[](Core* core, void* m) { static_cast<Mesh*>(m)->draw(core); } });
+	}
+
+	void submit(unsigned long long key, const RenderBinding& binding, unsigned int mesh_index,
+		unsigned int vs_slot, D3D12_GPU_VIRTUAL_ADDRESS vs_cb, D3D12_GPU_VIRTUAL_ADDRESS ps_cb, Mesh_Istancing* mesh)
+	{
+		items.push_back({ key, binding.pso, binding.tables[mesh_index], vs_slot, vs_cb, ps_cb, mesh,
+			[](Core* core, void* m) { static_cast<Mesh_Istancing*>(m)->draw(core); } });
+	}
+
+	//sort + replay everything submitted this frame
+	void flush(Core* core)
+	{
+		stats = RenderStats();
+		if (items.empty())
+			return;
+
+		// equal keys keep their submit order
+		std::stable_sort(items.begin(), items.end(),
+			[](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+		core->beginRenderPass();
+		ID3D12GraphicsCommandList4* list = core->getCommandList();
+		ID3D12PipelineState* current_pso = nullptr;
+		UINT64 current_table = 0;
+		D3D12_GPU_VIRTUAL_ADDRESS current_cbv[4] = { 0, 0, 0, 0 };
+
+		for (const DrawItem& item : items)
+		{
+			if (item.pso != current_pso)
+			{
+				list->SetPipelineState(item.pso);
+				current_pso = item.pso;
+				stats.pso_binds++;
+			}
+			else
+				stats.pso_skipped++;
+
+			if (item.table.ptr != current_table)
+			{
+				list->SetGraphicsRootDescriptorTable(2, item.table);
+				current_table = item.table.ptr;
+				stats.table_binds++;
+			}
+			else
+				stats.table_skipped++;
+
+			bind_cbv(list, item.vs_slot, item.vs_cb, current_cbv);
+			bind_cbv(list, 1, item.ps_cb, current_cbv);
+
+			item.draw(core, item.mesh);
+			stats.draws++;
+		}
+		items.clear();
+	}
+
+private:
+	void bind_cbv(ID3D12GraphicsCommandList4* list, unsigned int slot, D3D12_GPU_VIRTUAL_ADDRESS address, D3D12_GPU_VIRTUAL_ADDRESS* current)
+	{
+		if (address == 0)
+			return;
+		if (current[slot] == address)
+		{
+			stats.cbv_skipped++;
+			return;
+		}
+		list->SetGraphicsRootConstantBufferView(slot, address);
+		current[slot] = address;
+		stats.cbv_binds++;
+	}
+};
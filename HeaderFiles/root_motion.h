@@ -0,0 +1,315 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cctype>
+#include <cmath>
+#include "vectors.h"
+#include "animation.h"
+
+//Root motion
+/*
+– the clips are authored in place, the root bone ends where it starts while the feet push the ground backwards
+– extract() goes over every clip once at load:
+	• translation: feet near their lowest point are on the ground, the character moves by minus their horizontal slide
+	• steps with no foot down (a gallop's flight) carry on between the planted steps either side, the clip loops
+	• rotation: the turn that best maps the planted foot points of one keyframe onto the next (2D, least squares)
+	  turning on the spot only moves the feet, the root bone just sways
+	• per keyframe the running sum of both is kept, a Vec3 + a float per frame
+– sample(clip, t0, t1) is two lookups + lerps, a loop past the end adds the whole cycle
+– deltas are in the space the palette poses the mesh in, up is found from the skeleton (the bull is y up, the farmer -z)
+– the character turns them into world space with its own world matrix
+– nothing is sampled per frame, locomotion reads the delta for the dt the clip is about to play
+– a walk or run played at speed / speed(clip) covers speed units per second with its feet planted
+*/
+
+// bone name parts (lower case) that count as feet
+#define ROOT_MOTION_FOOT_NAMES { "foot", "ankle", "toe", "ball" }
+// a foot bone this close to its lowest point in the clip is on the ground
+#define ROOT_MOTION_CONTACT_HEIGHT 3.0f
+// planted points closer together than this (from their middle) give no turn
+#define ROOT_MOTION_TURN_SPREAD 10.0f
+// clips slower than this (units per second) do not travel: idles, attacks, turns
+#define ROOT_MOTION_MIN_SPEED 10.0f
+// clips with a foot down in less than this share of their steps do not travel, too little ground to measure against
+#define ROOT_MOTION_MIN_CONTACT 0.25f
+
+struct RootMotionClip
+{
+	// running sums at each keyframe, [0] = 0
+	std::vector<Vec3> translation;
+	std::vector<float> yaw;
+	float ticksPerSecond = 0;
+	float duration = 0;
+	// share of the steps with a foot on the ground
+	float contact = 0;
+};
+
+class RootMotion
+{
+public:
+	std::vector<RootMotionClip> clips;
+	std::vector<int> feet;
+	// posed model space up, axis 0..2 and sign
+	int up_axis = 1;
+	float up_sign = 1.0f;
+
+	//every clip of the animation, call once the clips are loaded
+	void extract(Animation* animation)
+	{
+		init(animation);
+		for (ClipHandle clip = 0; clip < (ClipHandle)animation->clips.size(); clip++)
+			extract_clip(animation, clip);
+	}
+
+	//feet + up only, extract_clip() then adds clips one at a time (lazily loaded clips), clip 0 has to be loaded
+	void init(Animation* animation)
+	{
+		feet.clear();
+		const char* names[] = ROOT_MOTION_FOOT_NAMES;
+		for (int i = 0; i < animation->bonesSize(); i++)
+		{
+			std::string name = animation->skeleton.bones[i].name;
+			for (char& c : name)
+				c = (char)tolower((unsigned char)c);
+			for (const char* part : names)
+			{
+				if (name.find(part) != std::string::npos)
+				{
+					feet.push_back(i);
+					break;
+				}
+			}
+		}
+		clips.assign(animation->clips.size(), RootMotionClip());
+		findUp(animation);
+	}
+
+	//the clip has to be loaded, a clip already extracted is skipped
+	void extract_clip(Animation* animation, ClipHandle clip)
+	{
+		if (animation->validClip(clip) && clip < (ClipHandle)clips.size() && clips[clip].translation.empty())
+			extractClip(animation, clip);
+	}
+
+	bool contains(ClipHandle clip) const
+	{
+		return clip >= 0 && clip < (ClipHandle)clips.size() && clips[clip].translation.size() > 1;
+	}
+
+	//root delta while the clip plays from t0 for dt seconds, wraps like a looping clip
+	void sample(ClipHandle clip, float t0, float dt, Vec3& translation, float& yaw) const
+	{
+		translation = Vec3(0, 0, 0);
+		yaw = 0;
+		if (!contains(clip) || dt <= 0)
+			return;
+		const RootMotionClip& c = clips[clip];
+		float t1 = t0 + dt;
+		// whole cycles, then what is left of the last one
+		float cycles = floorf(t1 / c.duration) - floorf(t0 / c.duration);
+		Vec3 start_t;
+		float start_yaw;
+		Vec3 end_t;
+		float end_yaw;
+		at(c, fmodf(max(t0, 0.0f), c.duration), start_t, start_yaw);
+		at(c, fmodf(max(t1, 0.0f), c.duration), end_t, end_yaw);
+		translation = end_t - start_t + c.translation.back() * cycles;
+		yaw = end_yaw - start_yaw + c.yaw.back() * cycles;
+	}
+
+	//average ground speed over the whole clip, units per second
+	float speed(ClipHandle clip) const
+	{
+		if (!contains(clip))
+			return 0;
+		return clips[clip].translation.back().length() / clips[clip].duration;
+	}
+
+	bool travels(ClipHandle clip) const
+	{
+		return speed(clip) > ROOT_MOTION_MIN_SPEED && clips[clip].contact >= ROOT_MOTION_MIN_CONTACT;
+	}
+
+	//how far the clip goes from t0 over dt along its overall direction, negative when a step goes backwards
+	float distance(ClipHandle clip, float t0, float dt) const
+	{
+		if (!travels(clip))
+			return 0;
+		Vec3 translation;
+		float yaw;
+		sample(clip, t0, dt, translation, yaw);
+		return translation.Dot(clips[clip].translation.back().Normalize());
+	}
+
+private:
+	//running sums at time t inside the clip
+	static void at(const RootMotionClip& c, float t, Vec3& translation, float& yaw)
+	{
+		float x = t * c.ticksPerSecond;
+		int last = (int)c.translation.size() - 1;
+		int frame = min((int)x, last);
+		int next = min(frame + 1, last);
+		float fact = min(x - (float)frame, 1.0f);
+		translation = c.translation[frame] + (c.translation[next] - c.translation[frame]) * fact;
+		yaw = c.yaw[frame] + (c.yaw[next] - c.yaw[frame]) * fact;
+	}
+
+	//rigid move from -> to in the ground plane: centroid shift + the angle around up (same way round as Matrix::rotateY for y up)
+	void fit(const std::vector<Vec3>& from, const std::vector<Vec3>& to, Vec3& shift, float& turn) const
+	{
+		float n = 1.0f / (float)from.size();
+		Vec3 from_center(0, 0, 0);
+		Vec3 to_center(0, 0, 0);
+		for (size_t i = 0; i < from.size(); i++)
+		{
+			from_center += from[i] * n;
+			to_center += to[i] * n;
+		}
+		shift = to_center - from_center;
+		// points bunched up (one foot, toe under the ankle) have no reliable turn
+		int u = (up_axis + 1) % 3;
+		int w = (up_axis + 2) % 3;
+		float cross = 0;
+		float dot = 0;
+		float spread = 0;
+		for (size_t i = 0; i < from.size(); i++)
+		{
+			Vec3 a = from[i] - from_center;
+			Vec3 b = to[i] - to_center;
+			cross += a.v[u] * b.v[w] - a.v[w] * b.v[u];
+			dot += a.v[u] * b.v[u] + a.v[w] * b.v[w];
+			spread = max(spread, a.v[u] * a.v[u] + a.v[w] * a.v[w]);
+		}
+		turn = spread > ROOT_MOTION_TURN_SPREAD * ROOT_MOTION_TURN_SPREAD ? up_sign * atan2f(cross, dot) : 0.0f;
+	}
+
+	float height(const Vec3& v) const
+	{
+		return v.v[up_axis] * up_sign;
+	}
+
+	Vec3 flat(const Vec3& v) const
+	{
+		Vec3 f = v;
+		f.v[up_axis] = 0;
+		return f;
+	}
+
+	//feet -> the average bone of the first pose of the first clip, snapped to an axis
+	void findUp(Animation* animation)
+	{
+		if (animation->clips.empty() || feet.empty())
+			return;
+		int bones = animation->bonesSize();
+		LocalPose pose;
+		std::vector<Matrix> globals(bones);
+		animation->clip(0)->samplePose(0, bones, pose);
+		animation->localToGlobal(pose, globals.data());
+		Vec3 body(0, 0, 0);
+		for (int i = 0; i < bones; i++)
+			body += globals[i].mulPoint(Vec3(0, 0, 0)) * (1.0f / (float)bones);
+		Vec3 base(0, 0, 0);
+		for (int foot : feet)
+			base += globals[foot].mulPoint(Vec3(0, 0, 0)) * (1.0f / (float)feet.size());
+		Vec3 up = body - base;
+		up_axis = 0;
+		for (int k = 1; k < 3; k++)
+		{
+			if (fabsf(up.v[k]) > fabsf(up.v[up_axis]))
+				up_axis = k;
+		}
+		up_sign = up.v[up_axis] < 0 ? -1.0f : 1.0f;
+	}
+
+	void extractClip(Animation* animation, ClipHandle clip)
+	{
+		AnimationSequence* sequence = animation->clip(clip);
+		RootMotionClip& c = clips[clip];
+		int frames = sequence->frameCount();
+		if (frames < 2)
+			return;
+		c.ticksPerSecond = sequence->ticksPerSecond;
+		c.duration = sequence->duration();
+		int bones = animation->bonesSize();
+		LocalPose pose;
+		std::vector<Matrix> globals(bones);
+		sequence->samplePose(0, bones, pose);
+		animation->localToGlobal(pose, globals.data());
+
+		// foot positions at every keyframe
+		unsigned int foot_count = (unsigned int)feet.size();
+		std::vector<Vec3> foot_positions((size_t)frames * foot_count);
+
+		for (int f = 0; f < frames; f++)
+		{
+			if (f > 0)
+			{
+				sequence->samplePose((float)f / c.ticksPerSecond, bones, pose);
+				animation->localToGlobal(pose, globals.data());
+			}
+			for (unsigned int k = 0; k < foot_count; k++)
+				foot_positions[(size_t)f * foot_count + k] = globals[feet[k]].mulPoint(Vec3(0, 0, 0));
+		}
+		// each foot bone's own ground height, toes sit lower than ankles
+		std::vector<float> ground(foot_count, FLT_MAX);
+		for (int f = 0; f < frames; f++)
+		{
+			for (unsigned int k = 0; k < foot_count; k++)
+				ground[k] = min(ground[k], height(foot_positions[(size_t)f * foot_count + k]));
+		}
+
+		// duration() has one frame past the last keyframe, the pose holds the last keyframe over it
+		// step f goes from keyframe f - 1 to f
+		std::vector<Vec3> slide(frames, Vec3(0, 0, 0));
+		std::vector<float> swing(frames, 0.0f);
+		std::vector<int> planted;
+		std::vector<Vec3> from;
+		std::vector<Vec3> to;
+		for (int f = 1; f < frames; f++)
+		{
+			// the planted feet slide (and swing) backwards as fast as the body goes (and turns) forwards
+			from.clear();
+			to.clear();
+			for (unsigned int k = 0; k < foot_count; k++)
+			{
+				const Vec3& a = foot_positions[(size_t)(f - 1) * foot_count + k];
+				const Vec3& b = foot_positions[(size_t)f * foot_count + k];
+				if (height(a) - ground[k] < ROOT_MOTION_CONTACT_HEIGHT && height(b) - ground[k] < ROOT_MOTION_CONTACT_HEIGHT)
+				{
+					from.push_back(flat(a));
+					to.push_back(flat(b));
+				}
+			}
+			if (!from.empty())
+			{
+				fit(from, to, slide[f], swing[f]);
+				planted.push_back(f);
+			}
+		}
+		c.contact = (float)planted.size() / (float)(frames - 1);
+
+		// nothing planted (a gallop in the air): lerp between the planted steps before + after, round the loop
+		for (size_t i = 0; i < planted.size(); i++)
+		{
+			int before = planted[i];
+			int after = i + 1 < planted.size() ? planted[i + 1] : planted[0] + frames - 1;
+			for (int f = before + 1; f < after; f++)
+			{
+				int step = (f - 1) % (frames - 1) + 1;
+				float fact = (float)(f - before) / (float)(after - before);
+				slide[step] = slide[before] + (slide[(after - 1) % (frames - 1) + 1] - slide[before]) * fact;
+				swing[step] = swing[before] + (swing[(after - 1) % (frames - 1) + 1] - swing[before]) * fact;
+			}
+		}
+
+		c.translation.assign(frames + 1, Vec3(0, 0, 0));
+		c.yaw.assign(frames + 1, 0.0f);
+		for (int f = 1; f < frames; f++)
+		{
+			c.translation[f] = c.translation[f - 1] - slide[f];
+			c.yaw[f] = c.yaw[f - 1] - swing[f];
+		}
+		c.translation[frames] = c.translation[frames - 1];
+		c.yaw[frames] = c.yaw[frames - 1];
+	}
+};
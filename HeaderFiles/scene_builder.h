@@ -0,0 +1,251 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include "map_item.h"
+#include "asset_loader.h"
+#include "gem_scene.h"
+#include "material_table.h"
+
+//Scene batches
+/*
+– a GEMScene (filename + world per instance) becomes one Item_Ins_Base per mesh + material, drawn instanced
+– load() parses with GEMSceneParser and groups the instances, nothing needs the device until init()
+– the material is the instance's properties parsed into a MaterialTable, instances with equal tables share a batch:
+	• vertex_animation – wind in the vertex shader (VS_Static_Ins_VAni)
+	• hitbox – the batch collides, its world_hitboxs are built with the instance buffer
+	• depth_sort – alpha foliage, sorted far to near every frame
+– one Mesh_Istancing instance buffer per batch mesh, sized for the batch
+– colliders is the batches with a hitbox, it goes to the player / NPC collision like the hand made items did
+– reload() reads the file again and keeps every batch whose model + material is still there:
+	• it only gets the new matrices, hitboxes are transformed again for the instances that moved
+	• new batches are built, batches nobody uses any more are freed, colliders is updated in place
+*/
+
+struct SceneBatch
+{
+	std::string model_name;
+	MaterialTable material;
+	bool vertex_animation = false;
+	bool hitbox = false;
+	bool depth_sort = false;
+	std::vector<INSTANCE> instances;
+};
+
+class Scene_Builder
+{
+public:
+	std::vector<SceneBatch> groups;
+	std::vector<Item_Ins_Base*> batches;
+	std::vector<Item_Ins_Base*> colliders;
+	// material of each batch
+	std::vector<MaterialTable> materials;
+	std::string filename;
+	unsigned int instance_count = 0;
+	// last reload(): instances that moved, batches built + dropped
+	unsigned int moved = 0;
+	unsigned int built = 0;
+	unsigned int dropped = 0;
+
+	~Scene_Builder()
+	{
+		clear();
+	}
+
+	//parse + group, false when the file does not parse
+	bool load(const std::string& _filename)
+	{
+		filename = _filename;
+		GEMLoader::GEMScene scene;
+		GEMSceneParser parser;
+		if (!parser.load(filename, scene))
+			return false;
+		group(scene);
+		return true;
+	}
+
+	//instances with the same model and material go to one batch, in the order the batches first appear
+	void group(const GEMLoader::GEMScene& scene)
+	{
+		groups.clear();
+		instance_count = 0;
+		// model -> its batches, a model has only a few materials
+		std::unordered_map<std::string, std::vector<unsigned int>> found;
+		for (const GEMLoader::GEMInstance& instance : scene.instances)
+		{
+			std::string model_name = scene_model_name(instance.meshFilename);
+			if (model_name.empty())
+				continue;
+			MaterialTable material;
+			material.parse(instance.material);
+			std::vector<unsigned int>& batches = found[model_name];
+			unsigned int batch = (unsigned int)groups.size();
+			for (unsigned int i : batches)
+			{
+				if (groups[i].material == material)
+					batch = i;
+			}
+			if (batch == groups.size())
+			{
+				batches.push_back(batch);
+				SceneBatch group;
+				group.model_name = model_name;
+				group.material = material;
+				group.vertex_animation = material.get_bool(MATERIAL_VERTEX_ANIMATION);
+				group.hitbox = material.get_bool(MATERIAL_HITBOX);
+				group.depth_sort = material.get_bool(MATERIAL_DEPTH_SORT);
+				groups.push_back(group);
+			}
+			INSTANCE matrix;
+			memcpy(matrix.w.m, instance.w.m, sizeof(instance.w.m));
+			groups[batch].instances.push_back(matrix);
+			instance_count++;
+		}
+	}
+
+	//the batches' models start loading on the job system
+	void prefetch(AssetLoader* assets)
+	{
+		for (const SceneBatch& group : groups)
+			assets->model(group.model_name);
+	}
+
+	//one instanced Item_Ins_Base per batch, the grouped matrices move into it
+	void init(Core* core, Shader_Manager* _shader_manager, PSOManager* _psos, Texture_Manager* _textures, AssetLoader* assets = nullptr)
+	{
+		shader_manager = _shader_manager;
+		psos = _psos;
+		textures = _textures;
+		clear();
+		for (SceneBatch& group : groups)
+		{
+			add_batch(core, group);
+			if (assets)
+				assets->uploaded(group.model_name);
+		}
+		groups.clear();
+	}
+
+	//hot reload, false keeps the scene as it was (the file does not parse)
+	bool reload(Core* core)
+	{
+		GEMLoader::GEMScene scene;
+		GEMSceneParser parser;
+		if (!parser.load(filename, scene))
+			return false;
+		group(scene);
+		std::vector<Item_Ins_Base*> old_batches;
+		std::vector<MaterialTable> old_materials;
+		old_batches.swap(batches);
+		old_materials.swap(materials);
+		colliders.clear();
+		moved = 0;
+		built = 0;
+		dropped = 0;
+		for (SceneBatch& group : groups)
+		{
+			Item_Ins_Base* batch = nullptr;
+			for (unsigned int i = 0; i < old_batches.size() && !batch; i++)
+			{
+				if (old_batches[i] && old_batches[i]->name == group.model_name && old_materials[i] == group.material)
+				{
+					batch = old_batches[i];
+					old_batches[i] = nullptr;
+				}
+			}
+			if (!batch)
+			{
+				add_batch(core, group);
+				built++;
+				continue;
+			}
+			moved += batch->set_instances(core, group.instances);
+			batches.push_back(batch);
+			materials.push_back(group.material);
+			if (group.hitbox)
+				colliders.push_back(batch);
+		}
+		groups.clear();
+		for (Item_Ins_Base* batch : old_batches)
+		{
+			if (!batch)
+				continue;
+			// the last frame may still be drawing it
+			if (dropped == 0)
+				core->flushGraphicsQueue();
+			batch->model.free();
+			delete batch;
+			dropped++;
+		}
+		return true;
+	}
+
+	void set_render_queue(Core* core, RenderQueue* queue)
+	{
+		render_queue = queue;
+		for (Item_Ins_Base* batch : batches)
+			batch->model.set_render_queue(core, queue);
+	}
+
+	void draw(Core* core, Matrix& vp)
+	{
+		for (Item_Ins_Base* batch : batches)
+			batch->draw(core, vp);
+	}
+
+	void clear()
+	{
+		for (Item_Ins_Base* batch : batches)
+			delete batch;
+		batches.clear();
+		colliders.clear();
+		materials.clear();
+	}
+
+	void print() const
+	{
+		std::cout << "Scene: " << instance_count << " instances in " << batches.size() << " batches, " << colliders.size() << " with hitboxes" << std::endl;
+		for (const Item_Ins_Base* batch : batches)
+			std::cout << "  " << batch->name << ": " << batch->model.instances_matix.size() << " instances" << (batch->model.depth_sort ? ", depth sorted" : "") << std::endl;
+	}
+
+	//the model files the batches were made from
+	void model_files(std::vector<std::string>& files) const
+	{
+		for (const Item_Ins_Base* batch : batches)
+			files.push_back("Models/" + batch->name + ".gem");
+	}
+
+	//"Models/acacia.gem", "acacia.gem" or "acacia" -> "acacia"
+	static std::string scene_model_name(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		if (name.size() > 4 && name.compare(name.size() - 4, 4, ".gem") == 0)
+			name.resize(name.size() - 4);
+		return name;
+	}
+
+private:
+	Shader_Manager* shader_manager = nullptr;
+	PSOManager* psos = nullptr;
+	Texture_Manager* textures = nullptr;
+	RenderQueue* render_queue = nullptr;
+
+	//the group's matrices move into the new batch
+	void add_batch(Core* core, SceneBatch& group)
+	{
+		Item_Ins_Base* batch = new Item_Ins_Base();
+		batch->model.instances_matix = std::move(group.instances);
+		batch->init_instances(core, shader_manager, psos, textures, group.model_name, group.vertex_animation, group.hitbox);
+		if (group.depth_sort)
+			batch->enable_depth_sort(core);
+		if (render_queue)
+			batch->model.set_render_queue(core, render_queue);
+		batches.push_back(batch);
+		materials.push_back(group.material);
+		if (group.hitbox)
+			colliders.push_back(batch);
+	}
+};
@@ -201,6 +201,17 @@ public:
 		//}
 	}
 
+	//copies dataSize bytes, for arrays that are only partly used
+	void update(const std::string& shader_name, const std::string& cb_name, const std::string& var_name, const void* data, unsigned int dataSize)
+	{
+		auto shader = shaders.find(shader_name);
+		if (shader == shaders.end())
+			return;
+		auto cb = shader->second.constantBuffers.find(cb_name);
+		if (cb != shader->second.constantBuffers.end())
+			cb->second.update(var_name, data, dataSize);
+	}
+
 	//void updateTexturePS(Core* core, std::string shader_name, std::string t_bindpoint, Texture* texture)
 	//{
 	//	shaders[shader_name].updateTexturePS(core, t_bindpoint, texture->heapOffset);
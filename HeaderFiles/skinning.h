@@ -0,0 +1,281 @@
+#pragma once
+#include <vector>
+#include <cfloat>
+#include <unordered_map>
+#include "vectors.h"
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#include <xmmintrin.h>
+#define CPU_SKINNING_SSE
+#endif
+
+//CPU skinning
+/*
+– the same sum as VS_Ani: transform = Σ bones[id] * weight, pos' = transform * pos
+– the positions, bone ids and weights are copied out of the mesh vertices once, 48 bytes per vertex
+– step keeps every step-th vertex + the outline of every bone (furthest vertices in 26 directions), enough for a hitbox
+– SSE, one vertex per iteration:
+	• the palette is transposed once per call, a bone is then 4 columns = 4 registers
+	• blended column j = Σ weight * column j, pos' = c0 * x + c1 * y + c2 * z + c3, no shuffles per vertex
+	• bounds are a min and a max register
+– skin_reference() is the plain float version of the same sum, to check the SSE path and the shader without a device
+– share() reads another CpuSkinning's vertices (a model shared by many characters), only the bounds + palette scratch are per character
+*/
+
+// every 16th vertex + the bone outlines, within about 2 units of the full box on the bull
+#define CPU_SKINNING_DEFAULT_STEP 16
+
+struct SkinnedVertex
+{
+	float pos[4];
+	unsigned int bones[4];
+	float weights[4];
+};
+
+class CpuSkinning
+{
+public:
+	std::vector<SkinnedVertex> vertices;
+	// set by share(), read instead of vertices
+	const std::vector<SkinnedVertex>* shared = nullptr;
+	// model space bounds of the last update_bounds(), the bind pose until then
+	Vec3 bounds_min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 bounds_max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	//VERTEX needs pos, bonesIDs and boneWeights (ANIMATED_VERTEX), one call per mesh
+	template<typename VERTEX>
+	void add(const std::vector<VERTEX>& mesh_vertices, unsigned int step = 1)
+	{
+		add(mesh_vertices.data(), (unsigned int)mesh_vertices.size(), step);
+	}
+
+	template<typename VERTEX>
+	void add(const VERTEX* mesh_vertices, unsigned int count, unsigned int step = 1)
+	{
+		if (count == 0)
+			return;
+		step = step > 0 ? step : 1;
+		// per main bone, the vertices furthest along 26 directions stay in however big the step is
+		// a bone moves its vertices rigidly, so its outline keeps being (close to) the outline
+		const unsigned int directions = 26;
+		float dirs[directions][3];
+		unsigned int n = 0;
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+				{
+					if (x == 0 && y == 0 && z == 0)
+						continue;
+					dirs[n][0] = (float)x;
+					dirs[n][1] = (float)y;
+					dirs[n][2] = (float)z;
+					n++;
+				}
+		std::unordered_map<unsigned int, std::vector<unsigned int>> outline;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const VERTEX& v = mesh_vertices[i];
+			bounds_min = Min(bounds_min, v.pos);
+			bounds_max = Max(bounds_max, v.pos);
+			unsigned int main_bone = 0;
+			for (unsigned int k = 1; k < 4; k++)
+			{
+				if (v.boneWeights[k] > v.boneWeights[main_bone])
+					main_bone = k;
+			}
+			std::vector<unsigned int>& best = outline[v.bonesIDs[main_bone]];
+			if (best.empty())
+				best.assign(directions, i);
+			for (unsigned int d = 0; d < directions; d++)
+			{
+				const Vec3& b = mesh_vertices[best[d]].pos;
+				if (v.pos.x * dirs[d][0] + v.pos.y * dirs[d][1] + v.pos.z * dirs[d][2] > b.x * dirs[d][0] + b.y * dirs[d][1] + b.z * dirs[d][2])
+					best[d] = i;
+			}
+		}
+		std::vector<unsigned char> keep(count, 0);
+		for (unsigned int i = 0; i < count; i += step)
+			keep[i] = 1;
+		for (auto& bone : outline)
+		{
+			for (unsigned int i : bone.second)
+				keep[i] = 1;
+		}
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (!keep[i])
+				continue;
+			const VERTEX& v = mesh_vertices[i];
+			SkinnedVertex s;
+			s.pos[0] = v.pos.x;
+			s.pos[1] = v.pos.y;
+			s.pos[2] = v.pos.z;
+			s.pos[3] = 1.0f;
+			for (unsigned int k = 0; k < 4; k++)
+			{
+				s.bones[k] = v.bonesIDs[k];
+				s.weights[k] = v.boneWeights[k];
+			}
+			vertices.push_back(s);
+		}
+	}
+
+	//skin source's vertices from now on, source has to outlive this
+	void share(const CpuSkinning& source)
+	{
+		vertices.clear();
+		shared = &source.vertices;
+		bounds_min = source.bounds_min;
+		bounds_max = source.bounds_max;
+	}
+
+	void clear()
+	{
+		vertices.clear();
+		shared = nullptr;
+	}
+
+	const std::vector<SkinnedVertex>& kept() const
+	{
+		return shared ? *shared : vertices;
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)kept().size();
+	}
+
+	//skinned positions of every kept vertex, out is resized
+	void skin(const Matrix* palette, unsigned int bone_count, std::vector<Vec3>& out)
+	{
+		const std::vector<SkinnedVertex>& source = kept();
+		out.resize(source.size());
+		transpose(palette, bone_count);
+#ifdef CPU_SKINNING_SSE
+		float p[4];
+		for (unsigned int i = 0; i < source.size(); i++)
+		{
+			_mm_storeu_ps(p, skin_vertex(source[i]));
+			out[i] = Vec3(p[0], p[1], p[2]);
+		}
+#else
+		for (unsigned int i = 0; i < source.size(); i++)
+			out[i] = skin_vertex(source[i]);
+#endif
+	}
+
+	//model space bounds of the skinned vertices, nothing is written out per vertex
+	void update_bounds(const Matrix* palette, unsigned int bone_count)
+	{
+		const std::vector<SkinnedVertex>& source = kept();
+		if (source.empty())
+			return;
+		transpose(palette, bone_count);
+#ifdef CPU_SKINNING_SSE
+		__m128 v_min = _mm_set1_ps(FLT_MAX);
+		__m128 v_max = _mm_set1_ps(-FLT_MAX);
+		for (const SkinnedVertex& v : source)
+		{
+			__m128 p = skin_vertex(v);
+			v_min = _mm_min_ps(v_min, p);
+			v_max = _mm_max_ps(v_max, p);
+		}
+		float lo[4], hi[4];
+		_mm_storeu_ps(lo, v_min);
+		_mm_storeu_ps(hi, v_max);
+		bounds_min = Vec3(lo[0], lo[1], lo[2]);
+		bounds_max = Vec3(hi[0], hi[1], hi[2]);
+#else
+		bounds_min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		bounds_max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const SkinnedVertex& v : source)
+		{
+			Vec3 p = skin_vertex(v);
+			bounds_min = Min(bounds_min, p);
+			bounds_max = Max(bounds_max, p);
+		}
+#endif
+	}
+
+	//plain float, straight from the shader, ids past the palette count as weight 0
+	static Vec3 skin_reference(const Matrix* palette, unsigned int bone_count, const SkinnedVertex& v)
+	{
+		float transform[12] = { 0 };
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			if (v.bones[k] >= bone_count)
+				continue;
+			for (unsigned int j = 0; j < 12; j++)
+				transform[j] += palette[v.bones[k]].m[j] * v.weights[k];
+		}
+		return Vec3(
+			transform[0] * v.pos[0] + transform[1] * v.pos[1] + transform[2] * v.pos[2] + transform[3],
+			transform[4] * v.pos[0] + transform[5] * v.pos[1] + transform[6] * v.pos[2] + transform[7],
+			transform[8] * v.pos[0] + transform[9] * v.pos[1] + transform[10] * v.pos[2] + transform[11]);
+	}
+
+private:
+	// per bone: column 0..3 of the palette matrix, rows 0..2 + a 0, one extra zero bone at the end
+	std::vector<float> columns;
+	unsigned int columns_bones = 0;
+
+	void transpose(const Matrix* palette, unsigned int bone_count)
+	{
+		columns.resize(((size_t)bone_count + 1) * 16);
+		columns_bones = bone_count;
+		for (unsigned int b = 0; b < bone_count; b++)
+		{
+			const float* m = palette[b].m;
+			float* c = &columns[(size_t)b * 16];
+			for (unsigned int j = 0; j < 4; j++)
+			{
+				c[j * 4 + 0] = m[j];
+				c[j * 4 + 1] = m[4 + j];
+				c[j * 4 + 2] = m[8 + j];
+				c[j * 4 + 3] = 0;
+			}
+		}
+		// bad ids land on the zero bone instead of reading past the palette
+		for (unsigned int j = 0; j < 16; j++)
+			columns[(size_t)bone_count * 16 + j] = 0;
+	}
+
+	const float* bone_columns(unsigned int bone) const
+	{
+		return &columns[(size_t)(bone < columns_bones ? bone : columns_bones) * 16];
+	}
+
+#ifdef CPU_SKINNING_SSE
+	__m128 skin_vertex(const SkinnedVertex& v) const
+	{
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const float* c = bone_columns(v.bones[k]);
+			__m128 w = _mm_set1_ps(v.weights[k]);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(c), w));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(c + 4), w));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(c + 8), w));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(c + 12), w));
+		}
+		__m128 p = _mm_mul_ps(c0, _mm_set1_ps(v.pos[0]));
+		p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(v.pos[1])));
+		p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(v.pos[2])));
+		return _mm_add_ps(p, c3);
+	}
+#else
+	Vec3 skin_vertex(const SkinnedVertex& v) const
+	{
+		float p[3] = { 0, 0, 0 };
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const float* c = bone_columns(v.bones[k]);
+			for (unsigned int r = 0; r < 3; r++)
+				p[r] += (c[r] * v.pos[0] + c[4 + r] * v.pos[1] + c[8 + r] * v.pos[2] + c[12 + r]) * v.weights[k];
+		}
+		return Vec3(p[0], p[1], p[2]);
+	}
+#endif
+};
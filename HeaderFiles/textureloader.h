@@ -3,6 +3,18 @@
 #include "stb_image.h"
 #include "core.h"
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+
+// 3 channel files are widened to 4, like the upload always expected
+struct TextureImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> texels;
+};
 
 class Texture
 {
@@ -10,30 +22,53 @@ public:
 	ID3D12Resource* tex;
 	int heapOffset;
 
-	void load(Core* core, std::string filename)
+	//file -> texels, no device calls so it can run on any thread
+	static bool decode(const std::string& filename, TextureImage& image)
 	{
 		int width = 0;
 		int height = 0;
 		int channels = 0;
 		unsigned char* texels = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+		if (!texels)
+		{
+			std::cerr << "Failed to load texture: " << filename << std::endl;
+			return false;
+		}
+		image.width = width;
+		image.height = height;
 		if (channels == 3) {
-			channels = 4;
-			unsigned char* texelsWithAlpha = new unsigned char[width * height * channels];
+			image.channels = 4;
+			image.texels.resize((size_t)width * height * 4);
+			unsigned char* texelsWithAlpha = image.texels.data();
 			for (int i = 0; i < (width * height); i++) {
 				texelsWithAlpha[i * 4] = texels[i * 3];
 				texelsWithAlpha[(i * 4) + 1] = texels[(i * 3) + 1];
 				texelsWithAlpha[(i * 4) + 2] = texels[(i * 3) + 2];
 				texelsWithAlpha[(i * 4) + 3] = 255;
 			}
-			// Initialize texture using width, height, channels, and texelsWithAlpha
-			upload(core, width, height, channels, texelsWithAlpha);
-			delete[] texelsWithAlpha;
 		}
 		else {
-			// Initialize texture using width, height, channels, and texels
-			upload(core, width, height, channels, texels);
+			image.channels = channels;
+			image.texels.assign(texels, texels + (size_t)width * height * channels);
 		}
 		stbi_image_free(texels);
+		return true;
+	}
+
+	//decoded takes the texels decoded ahead of time (AssetLoader) instead of reading the file, the entry is dropped once uploaded
+	void load(Core* core, std::string filename, std::unordered_map<std::string, TextureImage>* decoded = nullptr)
+	{
+		TextureImage image;
+		auto found = decoded ? decoded->find(filename) : std::unordered_map<std::string, TextureImage>::iterator();
+		if (decoded && found != decoded->end())
+		{
+			image = std::move(found->second);
+			decoded->erase(found);
+		}
+		else
+			decode(filename, image);
+		// Initialize texture using width, height, channels, and texels
+		upload(core, image.width, image.height, image.channels, image.texels.data());
 	}
 
 	void upload(Core* core, int width, int height, int channals, const void* data)
@@ -92,23 +127,25 @@ public:
 	Texture rmax;
 
 	unsigned int heapoffset;
+	// index in load order, for render queue sort keys
+	unsigned int id = 0;
 
-	void load(Core* core,std::string _name, std::vector<std::string> filenames)
+	void load(Core* core,std::string _name, std::vector<std::string> filenames, std::unordered_map<std::string, TextureImage>* decoded = nullptr)
 	{
 		if (filenames.size() == 3)
 		{
 			name = _name;
-			albedo.load(core, filenames[0]);
-			normalmapping.load(core, filenames[1]);
-			rmax.load(core, filenames[2]);
+			albedo.load(core, filenames[0], decoded);
+			normalmapping.load(core, filenames[1], decoded);
+			rmax.load(core, filenames[2], decoded);
 			heapoffset = albedo.heapOffset;
 		}
 	}
-	void load_onlyALB(Core* core,std::string _name,std::string filenames)
+	void load_onlyALB(Core* core,std::string _name,std::string filenames, std::unordered_map<std::string, TextureImage>* decoded = nullptr)
 	{
 
 			name = _name;
-			albedo.load(core, filenames);
+			albedo.load(core, filenames, decoded);
 			heapoffset = albedo.heapOffset;
 	}
 
@@ -125,13 +162,16 @@ class Texture_Manager
 {
 public:
 	std::unordered_map<std::string, Material* > materials;
+	// texels decoded off the main thread by the AssetLoader, by file name, uploaded when a material asks for them
+	std::unordered_map<std::string, TextureImage> decoded;
 	void load(Core* core, std::string name, std::vector<std::string> filenames)
 	{
 		if (materials.find(name) != materials.end())
 			return;
 
 		Material* material = new Material;
-		material->load(core, name, filenames);
+		material->load(core, name, filenames, &decoded);
+		material->id = (unsigned int)materials.size();
 		materials.insert({ name, material });
 	}
 
@@ -141,7 +181,8 @@ public:
 			return;
 
 		Material* material = new Material;
-		material->load_onlyALB(core, name, filenames);
+		material->load_onlyALB(core, name, filenames, &decoded);
+		material->id = (unsigned int)materials.size();
 		materials.insert({ name, material });
 	}
 
@@ -161,6 +202,13 @@ public:
 		return materials[name]->get_GPU_handle(core);
 	}
 	
+	unsigned int get_material_id(std::string name)
+	{
+		if (!find(name))
+			return 0;
+		return materials[name]->id;
+	}
+
 	void updateTexturePS(Core* core, std::string material)
 	{
 		core->getCommandList()->SetGraphicsRootDescriptorTable(2, get_material_GPU_handle(core, material));
@@ -0,0 +1,260 @@
+#include <vector>
+#include <iostream>
+#include "../HeaderFiles/index_buffer.h"
+
+//CPU test of the 16-bit index narrowing + splitting, no device needed
+/*
+– fits_16bit at the 65535 boundary, narrow_to_16bit keeps every value
+– split_16bit chunk boundaries + baseVertex on small chunks where the cuts are known
+– build() on meshes with more than 65535 vertices: every index resolves to the vertex it named before
+– exit code 0 = all passed, 1 = a check failed (each failure is printed)
+*/
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool condition, const char* text, int line)
+{
+	if (condition)
+		return;
+	std::cerr << "FAILED line " << line << ": " << text << std::endl;
+	failures++;
+}
+
+//vertex i is the 4 bytes of i, so a vertex tells which source vertex it came from
+static std::vector<unsigned int> id_vertices(unsigned int numVertices)
+{
+	std::vector<unsigned int> vertices(numVertices);
+	for (unsigned int i = 0; i < numVertices; i++)
+		vertices[i] = i;
+	return vertices;
+}
+
+//(n x n) vertex grid, two triangles per cell
+static std::vector<unsigned int> grid_indices(unsigned int n)
+{
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y + 1 < n; y++)
+	{
+		for (unsigned int x = 0; x + 1 < n; x++)
+		{
+			unsigned int a = y * n + x;
+			unsigned int quad[6] = { a, a + 1, a + n, a + 1, a + n + 1, a + n };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	return indices;
+}
+
+//every chunk's indices, with its baseVertex, name the same source vertex as the 32-bit list
+static bool round_trips(const IndexBufferData& data, const std::vector<unsigned int>& vertices, const std::vector<unsigned int>& indices,
+	unsigned int maxChunkVertices = INDEX_16BIT_MAX_VERTICES)
+{
+	const unsigned int* out = (const unsigned int*)data.vertexData(vertices.data());
+	unsigned int next_index = 0;
+	for (const IndexChunk& chunk : data.chunks)
+	{
+		// chunks follow each other, nothing skipped or drawn twice
+		if (chunk.startIndex != next_index)
+			return false;
+		next_index += chunk.indexCount;
+		for (unsigned int i = chunk.startIndex; i < chunk.startIndex + chunk.indexCount; i++)
+		{
+			unsigned int local = data.is16Bit ? data.indices16[i] : indices[i];
+			if (data.is16Bit && local >= maxChunkVertices)
+				return false;
+			unsigned int global = local + chunk.baseVertex;
+			if (global >= data.numVertices || out[global] != indices[i])
+				return false;
+		}
+	}
+	return next_index == indices.size();
+}
+
+static void test_fits_16bit()
+{
+	CHECK(IndexBufferBuilder::fits_16bit(0));
+	CHECK(IndexBufferBuilder::fits_16bit(3));
+	CHECK(IndexBufferBuilder::fits_16bit(65535));
+	CHECK(!IndexBufferBuilder::fits_16bit(65536));
+	CHECK(!IndexBufferBuilder::fits_16bit(251001));
+}
+
+static void test_narrow_to_16bit()
+{
+	std::vector<unsigned int> indices = { 0, 1, 2, 255, 256, 32767, 32768, 65534, 65535 };
+	std::vector<unsigned short> out = { 7, 7 };
+	IndexBufferBuilder::narrow_to_16bit(indices.data(), (unsigned int)indices.size(), out);
+	CHECK(out.size() == indices.size());
+	for (unsigned int i = 0; i < indices.size() && i < out.size(); i++)
+		CHECK(out[i] == indices[i]);
+}
+
+//a strip of 6 triangles over 8 vertices, 4 vertices per chunk
+static void test_split_boundaries()
+{
+	std::vector<unsigned int> vertices = id_vertices(8);
+	std::vector<unsigned int> indices = {
+		0, 1, 2,
+		1, 3, 2,
+		2, 3, 4,
+		3, 5, 4,
+		4, 5, 6,
+		5, 7, 6,
+	};
+	std::vector<unsigned char> outVertices;
+	std::vector<unsigned short> outIndices;
+	std::vector<IndexChunk> chunks;
+	IndexBufferBuilder::split_16bit(vertices.data(), sizeof(unsigned int), 8, indices.data(), (unsigned int)indices.size(),
+		outVertices, outIndices, chunks, 4);
+
+	// {0,1,2} + {1,3,2} fill the first chunk, {2,3,4} would be its 5th vertex
+	CHECK(chunks.size() == 3);
+	if (chunks.size() != 3)
+		return;
+	CHECK(chunks[0].startIndex == 0 && chunks[0].indexCount == 6 && chunks[0].baseVertex == 0);
+	CHECK(chunks[1].startIndex == 6 && chunks[1].indexCount == 6 && chunks[1].baseVertex == 4);
+	CHECK(chunks[2].startIndex == 12 && chunks[2].indexCount == 6 && chunks[2].baseVertex == 8);
+
+	// 2 + 3 are copied into the second chunk, 4 + 5 into the third
+	const unsigned int* out = (const unsigned int*)outVertices.data();
+	std::vector<unsigned int> expected = { 0, 1, 2, 3, 2, 3, 4, 5, 4, 5, 6, 7 };
+	CHECK(outVertices.size() == expected.size() * sizeof(unsigned int));
+	for (unsigned int i = 0; i < expected.size() && i * sizeof(unsigned int) < outVertices.size(); i++)
+		CHECK(out[i] == expected[i]);
+
+	CHECK(outIndices.size() == indices.size());
+	for (const IndexChunk& chunk : chunks)
+	{
+		for (unsigned int i = chunk.startIndex; i < chunk.startIndex + chunk.indexCount; i++)
+		{
+			CHECK(outIndices[i] < 4);
+			CHECK(out[outIndices[i] + chunk.baseVertex] == indices[i]);
+		}
+	}
+}
+
+//a vertex repeated in a degenerate triangle counts once
+static void test_split_degenerate()
+{
+	std::vector<unsigned int> vertices = id_vertices(5);
+	std::vector<unsigned int> indices = { 0, 0, 1, 1, 2, 2, 2, 3, 4 };
+	std::vector<unsigned char> outVertices;
+	std::vector<unsigned short> outIndices;
+	std::vector<IndexChunk> chunks;
+	IndexBufferBuilder::split_16bit(vertices.data(), sizeof(unsigned int), 5, indices.data(), (unsigned int)indices.size(),
+		outVertices, outIndices, chunks, 3);
+	CHECK(chunks.size() == 2);
+	if (chunks.size() != 2)
+		return;
+	CHECK(chunks[0].indexCount == 6 && chunks[0].baseVertex == 0);
+	CHECK(chunks[1].startIndex == 6 && chunks[1].baseVertex == 3);
+	CHECK(outVertices.size() == 6 * sizeof(unsigned int));
+}
+
+//65025 vertices, narrowed as they are
+static void test_build_small()
+{
+	std::vector<unsigned int> vertices = id_vertices(255 * 255);
+	std::vector<unsigned int> indices = grid_indices(255);
+	IndexBufferData data;
+	IndexBufferBuilder::build(vertices.data(), sizeof(unsigned int), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(), data);
+	CHECK(data.is16Bit);
+	CHECK(data.splitVertices.empty());
+	CHECK(data.numVertices == vertices.size());
+	CHECK(data.chunks.size() == 1);
+	CHECK(data.indexSizeInBytes() == 2);
+	CHECK(round_trips(data, vertices, indices));
+}
+
+//65536 vertices, one too many: split in two
+static void test_build_boundary()
+{
+	std::vector<unsigned int> vertices = id_vertices(256 * 256);
+	std::vector<unsigned int> indices = grid_indices(256);
+	IndexBufferData data;
+	IndexBufferBuilder::build(vertices.data(), sizeof(unsigned int), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(), data);
+	CHECK(data.is16Bit);
+	CHECK(data.chunks.size() == 2);
+	CHECK(!data.splitVertices.empty());
+	CHECK(round_trips(data, vertices, indices));
+}
+
+//the 501 x 501 sphere grid, 251001 vertices
+static void test_build_split()
+{
+	std::vector<unsigned int> vertices = id_vertices(501 * 501);
+	std::vector<unsigned int> indices = grid_indices(501);
+	IndexBufferData data;
+	IndexBufferBuilder::build(vertices.data(), sizeof(unsigned int), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(), data);
+	CHECK(data.is16Bit);
+	CHECK(data.chunks.size() >= 4);
+	CHECK(data.numIndices((unsigned int)indices.size()) == indices.size());
+	CHECK(data.numVertices * sizeof(unsigned int) == data.splitVertices.size());
+	// baseVertex is where the chunk's vertices start, they follow each other
+	for (unsigned int c = 1; c < data.chunks.size(); c++)
+		CHECK(data.chunks[c].baseVertex > data.chunks[c - 1].baseVertex && data.chunks[c].baseVertex - data.chunks[c - 1].baseVertex <= INDEX_16BIT_MAX_VERTICES);
+	CHECK(data.chunks.empty() || data.chunks[0].baseVertex == 0);
+	CHECK(round_trips(data, vertices, indices));
+}
+
+//random triangles over 70000 big vertices, the split copies so many that 32-bit stays smaller
+static void test_build_keeps_32bit()
+{
+	const unsigned int numVertices = 70000;
+	// 64 byte vertices, the first 4 bytes are the id
+	std::vector<unsigned int> vertices(numVertices * 16, 0);
+	for (unsigned int i = 0; i < numVertices; i++)
+		vertices[i * 16] = i;
+	std::vector<unsigned int> indices(600000);
+	unsigned int seed = 12345;
+	for (unsigned int& index : indices)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		index = (seed >> 8) % numVertices;
+	}
+	IndexBufferData data;
+	IndexBufferBuilder::build(vertices.data(), 64, numVertices, indices.data(), (unsigned int)indices.size(), data);
+	CHECK(!data.is16Bit);
+	CHECK(data.splitVertices.empty());
+	CHECK(data.indices16.empty());
+	CHECK(data.chunks.size() == 1 && data.chunks[0].indexCount == indices.size() && data.chunks[0].baseVertex == 0);
+	CHECK(data.indexData(indices.data()) == indices.data());
+	CHECK(data.indexSizeInBytes() == 4);
+
+	// the split itself still round trips
+	std::vector<unsigned char> outVertices;
+	std::vector<unsigned short> outIndices;
+	std::vector<IndexChunk> chunks;
+	IndexBufferBuilder::split_16bit(vertices.data(), 64, numVertices, indices.data(), (unsigned int)indices.size(), outVertices, outIndices, chunks);
+	bool ok = outIndices.size() == indices.size();
+	for (const IndexChunk& chunk : chunks)
+	{
+		for (unsigned int i = chunk.startIndex; i < chunk.startIndex + chunk.indexCount && ok; i++)
+		{
+			size_t vertex = (size_t)outIndices[i] + chunk.baseVertex;
+			ok = vertex * 64 < outVertices.size() && *(const unsigned int*)&outVertices[vertex * 64] == indices[i];
+		}
+	}
+	CHECK(ok);
+}
+
+int main()
+{
+	test_fits_16bit();
+	test_narrow_to_16bit();
+	test_split_boundaries();
+	test_split_degenerate();
+	test_build_small();
+	test_build_boundary();
+	test_build_split();
+	test_build_keeps_32bit();
+	if (failures > 0)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "index_buffer: all checks passed" << std::endl;
+	return 0;
+}
@@ -9,6 +9,8 @@
 #include "HeaderFiles/player.h"
 #include "HeaderFiles/npcs.h"
 #include "HeaderFiles/map_item.h"
+#include "HeaderFiles/scene_builder.h"
+#include "HeaderFiles/hot_reload.h"
 #include "HeaderFiles/ui.h"
 
 #define WINDOW_WIDTH 1024
@@ -22,6 +24,22 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	freopen_s(&fp, "CONOUT$", "w", stdout);
 
 	//create_matrix_files();
+	//create_scene_file();
+	//report_mesh_optimization();
+	//report_meshlets("Farmer-male");
+	//report_animation_packing("Bull-dark");
+	//report_animation_packing("Farmer-male");
+	//report_animation_jobs("Bull-dark");
+	//report_palette_bake("Bull-dark", { "idle", "trot forward", "run forward" });
+	//report_cpu_skinning("Bull-dark", "attack 01");
+	//report_root_motion("Bull-dark");
+	//report_root_motion("Farmer-male");
+	//report_gem_loading("Farmer-male");
+	//report_gem_loading("Bull-dark");
+	//report_cooked_loading("Farmer-male");
+	//report_cooked_loading("acacia");
+	//report_scene_parsing();
+	//report_material_lookup();
 
 	Window win;
 	Core core;
@@ -36,8 +54,30 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	PSOManager psos;
 	Texture_Manager tm;
 
+	// files are read + decoded on every core first, the inits below only upload
+	JobSystem job_system;
+	job_system.init();
+	AssetLoader assets;
+	assets.init(&job_system);
+	assets.model("acacia");
+	assets.model("Farmer-male");
+	assets.model("Bull-dark");
+	assets.texture("Models/Textures/grass_path_alb.png");
+	assets.texture("Models/Textures/grass_path_nh.png");
+	assets.texture("Models/Textures/grass_path_rmax.png");
+	assets.texture("Models/Textures/sunny_rose_garden.png");
+	for (int i = 0; i < 10; ++i)
+		assets.texture("UI/" + std::to_string(i) + ".png");
+	assets.instances(FILE_NAME_GROUND_MATRIX);
+	// fences, trees and foliage: one instanced batch per model + material of the level scene
+	Scene_Builder level;
+	level.load(FILE_NAME_LEVEL_SCENE);
+	level.prefetch(&assets);
+	assets.wait(&tm);
+
 	Object tree;
 	tree.init(&core, &sm, &psos, &tm, "acacia");
+	assets.uploaded("acacia");
 
 	//Object_Instance flower;
 	////Object flower;
@@ -51,13 +91,16 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	//Plane plane;
 	//plane.init(&core, &psos, &sm, &tm, "brown_mud_leaves_alb");
 	Ground_Grid ground;
-	ground.init(&core, &psos, &sm, &tm, "grass_path", FILE_NAME_GROUND_MATRIX, false, false);
+	ground.init(&core, &psos, &sm, &tm, "grass_path", FILE_NAME_GROUND_MATRIX, false, false, &assets);
+	assets.uploaded("ground");
 	Sphere sphere;
 	sphere.init(&core, &psos, &sm, &tm, "sunny_rose_garden");
+	assets.uploaded("sky");
 	 
 	UI_Manager um;
 	UI_Number ui_num;
 	ui_num.init_digits(&core, &sm, &psos, &tm, &um, -0.9, 0.9, 0.1, 0.15, 0.005);
+	assets.uploaded("digits");
 
 
 	//Camera camera(Vec3(10, 5, 10), Vec3(0, 1, 0), Vec3(0, 1, 0));
@@ -72,10 +115,12 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
 	Main_Charactor farmer;
 	farmer.init(&core, &sm, &psos, &tm, &camera_);
+	assets.uploaded("Farmer-male");
 
 	AnimalNPC bull;
 	bull.init_data();
 	bull.init(&core, &sm, &psos, &tm, "Bull-dark");
+	assets.uploaded("Bull-dark");
 	bull.set_target(&farmer);
 
 	float time = 0;
@@ -83,28 +128,37 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	//std::cout << "out" << std::endl;
 
 
-	// items with hitbox
-	Item_Ins_Base fence;
-	fence.init(&core, &sm, &psos, &tm, "Fence_Wooden_Old_Full_26h", FILE_NAME_FENCE_MATRIX, false, true);
-	Item_Ins_Base fence2;
-	fence2.init(&core, &sm, &psos, &tm, "pine2", FILE_NAME_MAP_BOUNDRAY_MATRIX, false, true);
-	Item_Ins_Base metal_fence;
-	metal_fence.init(&core, &sm, &psos, &tm, "Fence_Metal_Full_14g", FILE_NAME_METAL_FENCE_MATRIX, false, true);
+	// the fences + trees have hitboxes, the foliage is depth sorted
+	level.init(&core, &sm, &psos, &tm, &assets);
+	level.print();
+	assets.report();
+	ModelRegistry::get().print();
+	// clips idle for half a minute give their keyframes back, the next use reads them from the .gemc again
+	ModelRegistry::get().clip_evict_age = 30.0f;
+	// prefetched but never asked for
+	tm.decoded.clear();
+
+	// sorted replay of the world draws, the sky, hitboxes and UI still draw immediately
+	RenderQueue render_queue;
+	tree.set_render_queue(&core, &render_queue);
+	ground.grounds.set_render_queue(&core, &render_queue);
+	farmer.farmer.set_render_queue(&core, &render_queue);
+	bull.model.set_render_queue(&core, &render_queue);
+	level.set_render_queue(&core, &render_queue);
 
-	// no hitbox items
-	Item_Ins_Base flower;
-	flower.init(&core, &sm, &psos, &tm, "flower4", FILE_NAME_FLOWER_MATRIX, true, false);
-	Item_Ins_Base grass1;
-	grass1.init(&core, &sm, &psos, &tm, "Grass_Sets_Full_01e", FILE_NAME_GRASS_SET_MATRIX, true, false);
-	Item_Ins_Base grass2;
-	grass2.init(&core, &sm, &psos, &tm, "Dead_Plants_01d", FILE_NAME_GRASS_DEAD_MATRIX, true, false);
+	// animated characters evaluate their palettes in parallel, before any draw is recorded
+	AnimationJobs animation_jobs;
 
 	std::vector<NPC_Base*> npc_vec;
 	npc_vec.push_back(&bull);
-	std::vector<Item_Ins_Base*> item_vec;
-	item_vec.push_back(&fence);
-	item_vec.push_back(&fence2);
-	item_vec.push_back(&metal_fence);
+	// a scene reload updates the colliders in place
+	std::vector<Item_Ins_Base*>& item_vec = level.colliders;
+
+	// saving the level, an instance file or a batch model shows up in a moment
+	HotReload hot_reload;
+	hot_reload.init(&core);
+	hot_reload.watch(&ground);
+	hot_reload.watch(&level);
 
 
 	while (1) {
@@ -121,14 +175,28 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 		if (time > 1.0)
 		{
 			std::cout << camera_.position.get_string() << std::endl;
+			render_queue.stats.print();
+			animation_jobs.stats.print();
+			//ModelRegistry::get().print();
 			fps = static_cast<int>(1 / dt);
 			time = 0;
 		}
 			
 
+		// reloads upload through Core::uploadResource, which resets + executes the command list, so not inside the frame
+		hot_reload.update(dt);
+
 		core.beginFrame();
 		win.processMessages();
 
+		ModelRegistry::get().update(dt);
+		// game logic picks the clips, then every character animates at once
+		farmer.update(&core, &win, dt, npc_vec, item_vec);
+		bull.update(dt, item_vec);
+		farmer.queue_animation(&animation_jobs, dt);
+		bull.queue_animation(&animation_jobs, dt, &camera_);
+		animation_jobs.run(&job_system);
+
 		core.beginRenderPass();
 		cm.update_frameData(&core, dt, camera_.position);
 
@@ -146,15 +214,12 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 		//trex.draw(&core, world, camera_.view_projection, dt, "attack");
 
 		//farmer.update(&core, &win, dt);
-		farmer.draw(&core, &win, dt, npc_vec, item_vec);
-		bull.draw(&core, camera_.view_projection, dt, item_vec);
-
-		fence.draw(&core, camera_.view_projection);
-		fence2.draw(&core, camera_.view_projection);
-		metal_fence.draw(&core, camera_.view_projection);
-		flower.draw(&core, camera_.view_projection);
-		grass1.draw(&core, camera_.view_projection);
-		grass2.draw(&core, camera_.view_projection);
+		farmer.draw_animated(&core);
+		bull.draw_animated(&core, camera_.view_projection);
+
+		level.draw(&core, camera_.view_projection);
+
+		render_queue.flush(&core);
 
 		ui_num.draw_number(&core, fps);
 